@@ -0,0 +1,187 @@
+#include "analyzer.h"
+#include "solution_cache.h"
+#include "solver.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace {
+
+std::string csv_field(const std::string& text) {
+	if (text.find_first_of(",\"\n") == std::string::npos) {
+		return text;
+	}
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"') quoted += '"';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+std::string json_string(const std::string& text) {
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20) {
+			quoted += ' ';
+		}
+		else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+}
+
+LevelMetrics analyze_level(const Level& level, const AnalyzerOptions& options, SolverTelemetry* telemetry) {
+	SolverOptions solver_options;
+	solver_options.deadlocks = options.deadlocks;
+	solver_options.max_nodes = options.max_nodes;
+	solver_options.scratch_dir = options.scratch_dir;
+	solver_options.memory_budget = options.memory_budget;
+	solver_options.macros = options.macros;
+	solver_options.corrals = options.corrals;
+	solver_options.telemetry = telemetry;
+	Solver solver(level, solver_options);
+
+	LevelMetrics metrics;
+	metrics.title = level.get_title();
+	metrics.boxes = static_cast<int>(level.get_boxes().size());
+
+	if (solver.is_valid()) {
+		std::vector<bool> seen(static_cast<std::size_t>(solver.get_width()) * solver.get_height(), false);
+		std::vector<int> area = { solver.get_start_player() };
+		seen[area.front()] = true;
+		for (std::size_t i = 0; i < area.size(); i++) {
+			for (int d = 0; d < 4; d++) {
+				int next = area[i] + solver.get_offset(d);
+				if (seen[next] || solver.is_wall(next)) continue;
+				seen[next] = true;
+				area.push_back(next);
+			}
+		}
+		metrics.reachable_cells = static_cast<int>(area.size());
+		metrics.dead_squares = static_cast<int>(std::count_if(area.begin(), area.end(), [&solver](int cell) { return solver.is_dead_square(cell); }));
+		metrics.dead_ratio = static_cast<double>(metrics.dead_squares) / metrics.reachable_cells;
+	}
+
+	LevelHash hash;
+	CacheEntry entry;
+	if (options.cache) {
+		hash = content_hash(level);
+		metrics.cached = options.cache->lookup(hash, options.max_nodes, entry);
+		// A macro solution is not push-optimal, so it only stands in when macros are on.
+		if (metrics.cached && entry.solved && !entry.optimal && !options.macros) {
+			metrics.cached = false;
+		}
+	}
+	if (!metrics.cached) {
+		Solution solution = solver.solve();
+		const SolverStats& stats = solver.get_stats();
+		entry.solver_version = Solver::version;
+		entry.solved = solution.solved;
+		entry.optimal = solution.optimal;
+		entry.pushes = solution.pushes;
+		entry.max_nodes = options.max_nodes;
+		entry.nodes_expanded = stats.nodes_expanded;
+		entry.nodes_generated = stats.nodes_generated;
+		entry.seconds = stats.seconds;
+		entry.moves = solution.moves;
+		if (options.cache) {
+			options.cache->store(hash, entry);
+		}
+	}
+
+	metrics.solved = entry.solved;
+	metrics.pushes = entry.pushes;
+	metrics.moves = entry.moves.size();
+	metrics.nodes_expanded = entry.nodes_expanded;
+	metrics.nodes_generated = entry.nodes_generated;
+	metrics.branching = entry.nodes_expanded ? static_cast<double>(entry.nodes_generated) / entry.nodes_expanded : 0.0;
+	metrics.seconds = entry.seconds;
+	return metrics;
+}
+
+std::vector<LevelMetrics> analyze_levels(LevelSource& source, const AnalyzerOptions& options) {
+	std::vector<LevelMetrics> metrics;
+	std::mutex mutex;
+	std::size_t read = 0;
+	bool more = true;
+	std::exception_ptr error;
+	// Workers take the next level from the source under the lock, so no more levels than
+	// threads are held at a time.
+	auto worker = [&](unsigned thread) {
+		SolverTelemetry* telemetry = options.telemetry ? options.telemetry->get_slot(thread) : nullptr;
+		for (;;) {
+			std::optional<Level> level;
+			std::size_t i;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!more) return;
+				try {
+					level = source.next();
+				}
+				catch (...) {
+					error = std::current_exception();
+				}
+				if (!level) {
+					more = false;
+					return;
+				}
+				i = read++;
+			}
+			if (telemetry) telemetry->begin_level(i + 1);
+			LevelMetrics result = analyze_level(*level, options, telemetry);
+			result.index = i + 1;
+			if (telemetry) telemetry->end_level(result.solved);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (metrics.size() <= i) metrics.resize(i + 1);
+			metrics[i] = std::move(result);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	unsigned count = std::max(1u, options.threads);
+	for (unsigned i = 1; i < count; i++) {
+		pool.emplace_back(worker, i);
+	}
+	worker(0);
+	for (auto& thread : pool) {
+		thread.join();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return metrics;
+}
+
+void write_metrics_csv(std::ostream& out, const std::vector<LevelMetrics>& metrics) {
+	out << "index,title,boxes,reachable_cells,dead_squares,dead_ratio,solved,pushes,moves,nodes_expanded,nodes_generated,branching,seconds,cached\n";
+	for (const auto& m : metrics) {
+		out << m.index << ',' << csv_field(m.title) << ',' << m.boxes << ',' << m.reachable_cells << ',' << m.dead_squares << ','
+			<< m.dead_ratio << ',' << (m.solved ? 1 : 0) << ',' << m.pushes << ',' << m.moves << ',' << m.nodes_expanded << ','
+			<< m.nodes_generated << ',' << m.branching << ',' << m.seconds << ',' << (m.cached ? 1 : 0) << '\n';
+	}
+}
+
+void write_metrics_json(std::ostream& out, const std::vector<LevelMetrics>& metrics) {
+	out << "[\n";
+	for (std::size_t i = 0; i < metrics.size(); i++) {
+		const auto& m = metrics[i];
+		out << "  {\"index\": " << m.index << ", \"title\": " << json_string(m.title) << ", \"boxes\": " << m.boxes
+			<< ", \"reachable_cells\": " << m.reachable_cells << ", \"dead_squares\": " << m.dead_squares
+			<< ", \"dead_ratio\": " << m.dead_ratio << ", \"solved\": " << (m.solved ? "true" : "false")
+			<< ", \"pushes\": " << m.pushes << ", \"moves\": " << m.moves << ", \"nodes_expanded\": " << m.nodes_expanded
+			<< ", \"nodes_generated\": " << m.nodes_generated << ", \"branching\": " << m.branching
+			<< ", \"seconds\": " << m.seconds << ", \"cached\": " << (m.cached ? "true" : "false") << "}" << (i + 1 < metrics.size() ? "," : "") << '\n';
+	}
+	out << "]\n";
+}
@@ -0,0 +1,56 @@
+#ifndef ANALYZER_H_
+#define ANALYZER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "level.h"
+#include "level_source.h"
+
+class DeadlockDatabase;
+class SolutionCache;
+class TelemetryPublisher;
+struct SolverTelemetry;
+
+struct LevelMetrics {
+	std::size_t index = 0;
+	std::string title;
+	int boxes = 0;
+	int reachable_cells = 0;
+	int dead_squares = 0;
+	double dead_ratio = 0.0;
+	bool solved = false;
+	int pushes = 0;
+	std::size_t moves = 0;
+	uint64_t nodes_expanded = 0;
+	uint64_t nodes_generated = 0;
+	double branching = 0.0;
+	double seconds = 0.0;
+	bool cached = false;
+};
+
+struct AnalyzerOptions {
+	unsigned threads = 1;
+	uint64_t max_nodes = 0;
+	const DeadlockDatabase* deadlocks = nullptr;
+	SolutionCache* cache = nullptr;
+	std::string scratch_dir;
+	std::size_t memory_budget = 0;
+	bool macros = false;
+	bool corrals = true;
+	// Needs a slot per thread.
+	TelemetryPublisher* telemetry = nullptr;
+};
+
+// Computes static and solver metrics for every level of a pack on a pool of worker
+// threads, taking the levels from the source as the workers get to them. Results are
+// returned in pack order.
+std::vector<LevelMetrics> analyze_levels(LevelSource& source, const AnalyzerOptions& options);
+
+LevelMetrics analyze_level(const Level& level, const AnalyzerOptions& options, SolverTelemetry* telemetry = nullptr);
+
+void write_metrics_csv(std::ostream& out, const std::vector<LevelMetrics>& metrics);
+void write_metrics_json(std::ostream& out, const std::vector<LevelMetrics>& metrics);
+
+#endif
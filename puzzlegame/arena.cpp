@@ -0,0 +1,73 @@
+#include "arena.h"
+#include <algorithm>
+#include <new>
+
+Arena::Arena(std::size_t chunk_size) : chunk_size(chunk_size) {}
+
+Arena::~Arena() {
+	for (auto& chunk : chunks) {
+		::operator delete(chunk.data);
+	}
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+	while (current < chunks.size()) {
+		Chunk& chunk = chunks[current];
+		std::size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+		if (aligned + size <= chunk.size) {
+			stats.bytes_in_use += aligned + size - offset;
+			stats.high_water = std::max(stats.high_water, stats.bytes_in_use);
+			stats.allocations++;
+			offset = aligned + size;
+			return chunk.data + aligned;
+		}
+		stats.bytes_in_use += chunk.size - offset;
+		current++;
+		offset = 0;
+	}
+
+	std::size_t bytes = std::max(chunk_size, size + alignment);
+	Chunk chunk = { static_cast<char*>(::operator new(bytes)), bytes };
+	chunks.push_back(chunk);
+	current = chunks.size() - 1;
+	offset = 0;
+	stats.bytes_reserved += bytes;
+	stats.chunk_allocations++;
+	return allocate(size, alignment);
+}
+
+Arena::Marker Arena::mark() const {
+	return { current, offset, stats.bytes_in_use };
+}
+
+void Arena::release(const Marker& marker) {
+	current = marker.chunk;
+	offset = marker.offset;
+	stats.bytes_in_use = marker.in_use;
+}
+
+void Arena::reset() {
+	current = 0;
+	offset = 0;
+	stats.bytes_in_use = 0;
+}
+
+Arena& thread_arena() {
+	thread_local Arena arena;
+	return arena;
+}
+
+NodePool::NodePool(Arena& arena, std::size_t slot_size, std::size_t slots_per_block)
+	: arena(arena), slot_size((slot_size + 7) & ~static_cast<std::size_t>(7)), slots_per_block(slots_per_block) {}
+
+uint32_t NodePool::allocate() {
+	if (count == blocks.size() * slots_per_block) {
+		blocks.push_back(static_cast<char*>(arena.allocate(slot_size * slots_per_block, 8)));
+	}
+	return static_cast<uint32_t>(count++);
+}
+
+void NodePool::clear() {
+	blocks.clear();
+	count = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ArenaStats {
+	std::size_t bytes_in_use = 0;
+	std::size_t high_water = 0;
+	std::size_t bytes_reserved = 0;
+	uint64_t allocations = 0;
+	uint64_t chunk_allocations = 0;
+};
+
+// Bump allocator over large chunks. Nothing is freed individually: a search takes a
+// marker when it starts and releases everything allocated after it in one step. Chunks
+// are kept for reuse by the next search on the same thread.
+class Arena {
+public:
+	struct Marker {
+		std::size_t chunk;
+		std::size_t offset;
+		std::size_t in_use;
+	};
+
+	explicit Arena(std::size_t chunk_size = 1 << 20);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+	template <typename T>
+	T* allocate_array(std::size_t count) {
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	Marker mark() const;
+	void release(const Marker& marker);
+	void reset();
+
+	const ArenaStats& get_stats() const { return stats; }
+
+private:
+	struct Chunk {
+		char* data;
+		std::size_t size;
+	};
+
+	std::size_t chunk_size;
+	std::vector<Chunk> chunks;
+	std::size_t current = 0;
+	std::size_t offset = 0;
+	ArenaStats stats;
+};
+
+Arena& thread_arena();
+
+// Fixed-size slots carved out of an arena in blocks, addressed by a 32-bit index so
+// records can link to each other without pointers.
+class NodePool {
+public:
+	NodePool(Arena& arena, std::size_t slot_size, std::size_t slots_per_block = 4096);
+
+	uint32_t allocate();
+	void clear();
+
+	void* get(uint32_t index) const { return blocks[index / slots_per_block] + (index % slots_per_block) * slot_size; }
+	std::size_t size() const { return count; }
+	std::size_t get_slot_size() const { return slot_size; }
+
+private:
+	Arena& arena;
+	std::size_t slot_size;
+	std::size_t slots_per_block;
+	std::vector<char*> blocks;
+	std::size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "benchmark.h"
+#include "arena.h"
+#include "session_engine.h"
+#include "solver.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+
+void benchmark_solver(LevelSource& levels, const BenchmarkOptions& options, std::ostream& out) {
+	uint64_t expanded = 0;
+	uint64_t generated = 0;
+	double seconds = 0.0;
+	int solved = 0;
+	SolverTelemetry* telemetry = options.telemetry ? options.telemetry->get_slot(0) : nullptr;
+
+	std::size_t i = 0;
+	for (; std::optional<Level> next = levels.next(); i++) {
+		const Level& level = *next;
+		SolverOptions solver_options;
+		solver_options.max_nodes = options.max_nodes;
+		solver_options.deadlocks = options.deadlocks;
+		solver_options.scratch_dir = options.scratch_dir;
+		solver_options.memory_budget = options.memory_budget;
+		solver_options.macros = options.macros;
+		solver_options.corrals = options.corrals;
+		solver_options.telemetry = telemetry;
+		Solver solver(level, solver_options);
+		if (telemetry) telemetry->begin_level(i + 1);
+		Solution solution = solver.solve();
+		if (telemetry) telemetry->end_level(solution.solved);
+		const SolverStats& stats = solver.get_stats();
+
+		expanded += stats.nodes_expanded;
+		generated += stats.nodes_generated;
+		seconds += stats.seconds;
+		solved += solution.solved ? 1 : 0;
+		out << level.get_title() << ": " << (solution.solved ? "solved" : "unsolved") << ", pushes " << solution.pushes
+			<< ", expanded " << stats.nodes_expanded << ", " << stats.seconds << "s, "
+			<< (stats.seconds > 0.0 ? static_cast<uint64_t>(stats.nodes_expanded / stats.seconds) : 0) << " nodes/s, arena "
+			<< stats.memory.bytes_in_use << " bytes in use";
+		if (options.macros) {
+			out << ", " << stats.macro_pushes << " macro pushes";
+		}
+		if (options.corrals) {
+			out << ", " << stats.corral_prunes << " corral prunes";
+		}
+		if (!options.scratch_dir.empty()) {
+			out << ", " << stats.layers << " layers, " << stats.disk.runs << " runs, " << stats.disk.bytes_written << " bytes written, "
+				<< stats.disk.bytes_read << " bytes read";
+		}
+		out << '\n';
+	}
+
+	const ArenaStats& memory = thread_arena().get_stats();
+	out << "solved " << solved << "/" << i << ", expanded " << expanded << ", generated " << generated
+		<< " in " << seconds << "s, " << (seconds > 0.0 ? static_cast<uint64_t>(expanded / seconds) : 0) << " nodes/s\n";
+	out << "arena: high water " << memory.high_water << " bytes, reserved " << memory.bytes_reserved << " bytes, "
+		<< memory.allocations << " allocations, " << memory.chunk_allocations << " chunk allocations\n";
+}
+
+
+void benchmark_sessions(LevelSource& source, const SessionBenchmarkOptions& options, std::ostream& out) {
+	// Session i plays level i modulo the level count, so levels past the session count
+	// are never played and are not read.
+	std::vector<Level> levels;
+	while (levels.size() < options.sessions) {
+		std::optional<Level> level = source.next();
+		if (!level) break;
+		levels.push_back(std::move(*level));
+	}
+	if (levels.empty() || options.sessions == 0) {
+		throw std::runtime_error("Session benchmark needs levels and sessions");
+	}
+	SessionEngine engine;
+	std::vector<uint32_t> layouts;
+	for (const auto& level : levels) {
+		layouts.push_back(engine.add_layout(level));
+	}
+	std::vector<uint32_t> sessions(options.sessions);
+	for (std::size_t i = 0; i < options.sessions; i++) {
+		sessions[i] = engine.add_session(layouts[i % layouts.size()]);
+	}
+
+	// A fixed pool of move rounds, reused cyclically, keeps random number generation out
+	// of the timed loops.
+	const int pool = 64;
+	std::vector<std::vector<Direction>> moves(pool, std::vector<Direction>(options.sessions));
+	uint64_t state = options.seed | 1;
+	for (auto& round : moves) {
+		for (auto& direction : round) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			direction = static_cast<Direction>(state >> 62);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < options.rounds; round++) {
+		engine.step_batch(sessions, moves[round % pool]);
+	}
+	double engine_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<Level> games;
+	games.reserve(options.sessions);
+	for (std::size_t i = 0; i < options.sessions; i++) {
+		games.push_back(levels[i % levels.size()].clone());
+	}
+	start = std::chrono::steady_clock::now();
+	for (int round = 0; round < options.rounds; round++) {
+		const std::vector<Direction>& round_moves = moves[round % pool];
+		for (std::size_t i = 0; i < options.sessions; i++) {
+			games[i].step(round_moves[i]);
+		}
+	}
+	double level_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::size_t mismatches = 0;
+	uint64_t pushes = 0;
+	std::size_t completed = 0;
+	for (std::size_t i = 0; i < options.sessions; i++) {
+		std::vector<std::pair<int, int>> boxes = games[i].get_boxes();
+		std::vector<std::pair<int, int>> engine_boxes = engine.get_boxes(sessions[i]);
+		std::sort(boxes.begin(), boxes.end());
+		std::sort(engine_boxes.begin(), engine_boxes.end());
+		bool same = engine.get_player(sessions[i]) == games[i].get_player() && static_cast<int>(engine.get_steps(sessions[i])) == games[i].get_steps()
+			&& engine.is_completed(sessions[i]) == games[i].is_completed() && boxes == engine_boxes;
+		mismatches += same ? 0 : 1;
+		pushes += engine.get_pushes(sessions[i]);
+		completed += engine.is_completed(sessions[i]) ? 1 : 0;
+	}
+
+	double total = static_cast<double>(options.sessions) * options.rounds;
+	out << options.sessions << " sessions on " << levels.size() << " layouts, " << options.rounds << " steps each, "
+		<< pushes << " pushes, " << completed << " completed\n";
+	out << "session engine: " << engine_seconds << "s, " << static_cast<uint64_t>(total / engine_seconds) << " session steps/s\n";
+	out << "Level::step:    " << level_seconds << "s, " << static_cast<uint64_t>(total / level_seconds) << " session steps/s\n";
+	out << "end states differing from Level::step: " << mismatches << "\n";
+}
+
+void benchmark_steps(LevelSource& levels, const StepBenchmarkOptions& options, std::ostream& out) {
+	if (options.steps == 0) {
+		throw std::runtime_error("Step benchmark needs levels and steps");
+	}
+	std::vector<Direction> moves(4096);
+	uint64_t state = options.seed | 1;
+	for (auto& direction : moves) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		direction = static_cast<Direction>(state >> 62);
+	}
+
+	// Levels are timed one at a time as they are read and added to their width class.
+	struct WidthClass {
+		int width;
+		std::size_t count;
+		uint64_t moved;
+		double seconds;
+	};
+	WidthClass classes[] = { { 16, 0, 0, 0.0 }, { 32, 0, 0, 0.0 }, { 64, 0, 0, 0.0 }, { 0, 0, 0, 0.0 } };
+	std::size_t total_levels = 0;
+	while (std::optional<Level> level = levels.next()) {
+		WidthClass* width_class = std::find_if(std::begin(classes), std::end(classes), [&level](const WidthClass& c) { return c.width == level->get_width_class(); });
+		if (width_class == std::end(classes)) {
+			continue;
+		}
+		auto start = std::chrono::steady_clock::now();
+		Level game = level->clone();
+		for (uint64_t i = 0; i < options.steps; i++) {
+			game.step(moves[i & (moves.size() - 1)]);
+		}
+		width_class->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		width_class->moved += game.get_steps();
+		width_class->count++;
+		total_levels++;
+	}
+	if (total_levels == 0) {
+		throw std::runtime_error("Step benchmark needs levels and steps");
+	}
+
+	uint64_t total_steps = 0;
+	double total_seconds = 0.0;
+	for (const WidthClass& width_class : classes) {
+		if (width_class.count == 0) {
+			continue;
+		}
+		uint64_t steps = options.steps * width_class.count;
+		total_steps += steps;
+		total_seconds += width_class.seconds;
+		out << (width_class.width ? "rows of " + std::to_string(width_class.width) + " cells" : std::string("wider boards")) << ": " << width_class.count
+			<< " levels, " << steps << " steps (" << width_class.moved << " moved) in " << width_class.seconds << "s, "
+			<< static_cast<uint64_t>(steps / width_class.seconds) << " steps/s\n";
+	}
+	out << "total: " << total_steps << " steps in " << total_seconds << "s, " << static_cast<uint64_t>(total_steps / total_seconds) << " steps/s\n";
+}
+
+void benchmark_portfolio(LevelSource& levels, const PortfolioOptions& options, std::ostream& out) {
+	std::vector<PortfolioStrategy> strategies = default_strategies();
+	PortfolioSolver portfolio(strategies, options);
+	int solved = 0;
+	int optimal = 0;
+	double seconds = 0.0;
+	std::size_t count = 0;
+	for (; std::optional<Level> next = levels.next(); count++) {
+		const Level& level = *next;
+		PortfolioResult result = portfolio.solve(level);
+		seconds += result.seconds;
+		solved += result.solution.solved ? 1 : 0;
+		optimal += result.solution.optimal ? 1 : 0;
+		out << level.get_title() << ": ";
+		if (result.winner >= 0) {
+			out << "solved by " << strategies[result.winner].name << ", pushes " << result.solution.pushes
+				<< (result.solution.optimal ? " (optimal)" : "");
+		}
+		else {
+			out << "unsolved";
+		}
+		out << ", " << result.nodes_expanded << " nodes expanded by all strategies, " << result.seconds << "s\n";
+	}
+	out << "solved " << solved << "/" << count << " (" << optimal << " optimal) in " << seconds << "s\n";
+	for (const auto& entry : portfolio.get_stats()) {
+		out << entry.name << ": " << entry.races << " races, " << entry.solved << " solved, " << entry.wins << " wins, "
+			<< entry.seconds << "s\n";
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "level.h"
+#include "level_source.h"
+#include "portfolio.h"
+
+class DeadlockDatabase;
+class TelemetryPublisher;
+
+struct BenchmarkOptions {
+	uint64_t max_nodes = 0;
+	const DeadlockDatabase* deadlocks = nullptr;
+	std::string scratch_dir;
+	std::size_t memory_budget = 0;
+	bool macros = false;
+	bool corrals = true;
+	// Slot 0 gets the counters.
+	TelemetryPublisher* telemetry = nullptr;
+};
+
+// Solves every level on the calling thread and reports per level and total node
+// throughput together with the thread arena's allocator statistics.
+void benchmark_solver(LevelSource& levels, const BenchmarkOptions& options, std::ostream& out);
+
+struct SessionBenchmarkOptions {
+	std::size_t sessions = 10000;
+	int rounds = 1000;
+	uint64_t seed = 1;
+};
+
+// Steps many sessions spread over the levels with random moves through SessionEngine on
+// the calling thread, then replays the same moves on Level objects as a baseline, and
+// reports session steps per second for both and whether their end states agree. Only
+// the first level per session is read.
+void benchmark_sessions(LevelSource& levels, const SessionBenchmarkOptions& options, std::ostream& out);
+
+struct StepBenchmarkOptions {
+	uint64_t steps = 100000;
+	uint64_t seed = 1;
+};
+
+// Plays random moves on a copy of every level through Level::step on the calling thread
+// and reports steps/s for each board width class the movement code is compiled for.
+void benchmark_steps(LevelSource& levels, const StepBenchmarkOptions& options, std::ostream& out);
+
+// Solves every level with a portfolio of the default strategies and reports the winner
+// per level, then races, solutions, wins and time per strategy.
+void benchmark_portfolio(LevelSource& levels, const PortfolioOptions& options, std::ostream& out);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef CAMERA_H_
+#define CAMERA_H_
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <SDL.h>
+
+// Maps level cells to screen pixels. The view follows the player and eases towards
+// its target position and zoom, so large levels scroll and zoom smoothly.
+class Camera {
+public:
+	static constexpr double min_cell_width = 8.0;
+	static constexpr double max_cell_width = 256.0;
+	static constexpr double native_cell_width = 128.0;
+	static constexpr double readable_cell_width = 32.0;
+	static constexpr double zoom_step = 1.25;
+	static constexpr double ease_rate = 12.0;
+
+	// row_ratio is the row pitch relative to the cell width, overhang how many rows
+	// the sprites of the top row reach above it.
+	Camera(double row_ratio, double overhang) : row_ratio(row_ratio), overhang(overhang) {}
+
+	// Frames a new level: small levels are fitted into the viewport, larger ones start
+	// on the focus cell at a readable size.
+	void reset(std::pair<int, int> dimensions, std::pair<int, int> focus, const SDL_Rect& view) {
+		level_dimensions = dimensions;
+		viewport = view;
+		target_width = fit_width();
+		cell_width = target_width;
+		center = target_center(focus);
+	}
+
+	void zoom_by(double factor) {
+		target_width = std::clamp(target_width * factor, min_cell_width, max_cell_width);
+	}
+
+	void zoom_to_fit() {
+		target_width = fit_width();
+	}
+
+	void update(std::pair<int, int> focus, double seconds) {
+		double blend = 1.0 - std::exp(-ease_rate * std::max(seconds, 0.0));
+		cell_width *= std::pow(target_width / cell_width, blend);
+		if (std::abs(cell_width - target_width) < 0.01) {
+			cell_width = target_width;
+		}
+		std::pair<double, double> target = target_center(focus);
+		center.first += (target.first - center.first) * blend;
+		center.second += (target.second - center.second) * blend;
+	}
+
+	// Cells whose sprites can touch the viewport, as [first, last) columns and rows.
+	SDL_Rect visible_cells() const {
+		double half_cols = viewport.w / cell_width / 2.0;
+		double half_rows = viewport.h / row_height() / 2.0;
+		int col0 = std::max(0, static_cast<int>(std::floor(center.first - half_cols)));
+		int col1 = std::min(level_dimensions.first, static_cast<int>(std::ceil(center.first + half_cols)));
+		int row0 = std::max(0, static_cast<int>(std::floor(center.second - half_rows)));
+		int row1 = std::min(level_dimensions.second, static_cast<int>(std::ceil(center.second + half_rows + overhang)));
+		return { col0, row0, std::max(0, col1 - col0), std::max(0, row1 - row0) };
+	}
+
+	std::pair<int, int> to_screen(int col, int row) const {
+		int x = viewport.x + static_cast<int>(std::floor(viewport.w / 2.0 + (col - center.first) * cell_width));
+		int y = viewport.y + static_cast<int>(std::floor(viewport.h / 2.0 + (row - center.second) * row_height()));
+		return std::make_pair(x, y);
+	}
+
+	double get_cell_width() const { return cell_width; }
+
+	const SDL_Rect& get_viewport() const { return viewport; }
+
+private:
+	double row_ratio;
+	double overhang;
+	std::pair<int, int> level_dimensions = { 0, 0 };
+	SDL_Rect viewport = { 0, 0, 0, 0 };
+	double cell_width = native_cell_width;
+	double target_width = native_cell_width;
+	std::pair<double, double> center = { 0.0, 0.0 };
+
+	double row_height() const {
+		return cell_width * row_ratio;
+	}
+
+	double fit_width() const {
+		double fit_x = viewport.w / static_cast<double>(std::max(level_dimensions.first, 1));
+		double fit_y = viewport.h / ((std::max(level_dimensions.second, 1) + overhang) * row_ratio);
+		return std::clamp(std::min(fit_x, fit_y), readable_cell_width, native_cell_width);
+	}
+
+	// Centers an axis that fits in the view, otherwise keeps the focus in the middle
+	// without scrolling past the level edges.
+	static double clamp_axis(double focus, double extent_begin, double extent_end, double visible) {
+		if (extent_end - extent_begin <= visible) {
+			return (extent_begin + extent_end) / 2.0;
+		}
+		return std::clamp(focus, extent_begin + visible / 2.0, extent_end - visible / 2.0);
+	}
+
+	std::pair<double, double> target_center(std::pair<int, int> focus) const {
+		double visible_cols = viewport.w / cell_width;
+		double visible_rows = viewport.h / row_height();
+		return std::make_pair(
+			clamp_axis(focus.first + 0.5, 0.0, level_dimensions.first, visible_cols),
+			clamp_axis(focus.second + 0.5, -overhang, level_dimensions.second, visible_rows));
+	}
+};
+
+#endif
\ No newline at end of file
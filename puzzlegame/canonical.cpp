@@ -0,0 +1,317 @@
+#include "canonical.h"
+#include "level.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace {
+
+struct Grid {
+	int width = 0;
+	int height = 0;
+	std::vector<char> cells;
+
+	char& at(int x, int y) { return cells[y * width + x]; }
+	char at(int x, int y) const { return cells[y * width + x]; }
+};
+
+// Level knows the classic characters only; the readers map the XSB letters onto them.
+char normalize_cell(char cell) {
+	switch (cell) {
+	case '#':
+	case '.':
+	case '$':
+	case '*':
+	case '@':
+	case '+':
+		return cell;
+	default:
+		return ' ';
+	}
+}
+
+bool is_player(char cell) {
+	return cell == '@' || cell == '+';
+}
+
+bool is_box(char cell) {
+	return cell == '$' || cell == '*';
+}
+
+std::vector<bool> flood(const Grid& grid, const std::vector<int>& seeds, bool boxes_block) {
+	std::vector<bool> seen(grid.cells.size(), false);
+	std::deque<int> open;
+	for (int seed : seeds) {
+		seen[seed] = true;
+		open.push_back(seed);
+	}
+	while (!open.empty()) {
+		int index = open.front();
+		open.pop_front();
+		int x = index % grid.width;
+		int y = index / grid.width;
+		const int dx[] = { -1, 1, 0, 0 };
+		const int dy[] = { 0, 0, -1, 1 };
+		for (int d = 0; d < 4; d++) {
+			int nx = x + dx[d];
+			int ny = y + dy[d];
+			if (nx < 0 || ny < 0 || nx >= grid.width || ny >= grid.height) continue;
+			int next = ny * grid.width + nx;
+			char cell = grid.cells[next];
+			if (seen[next] || cell == '#' || (boxes_block && is_box(cell))) continue;
+			seen[next] = true;
+			open.push_back(next);
+		}
+	}
+	return seen;
+}
+
+Grid read_grid(const Level& level) {
+	const auto& board = level.get_board();
+	Grid grid;
+	grid.height = static_cast<int>(board.size());
+	for (const auto& row : board) {
+		grid.width = std::max(grid.width, static_cast<int>(row.size()));
+	}
+	grid.cells.assign(static_cast<std::size_t>(grid.width) * grid.height, ' ');
+	for (int y = 0; y < grid.height; y++) {
+		for (int x = 0; x < static_cast<int>(board[y].size()); x++) {
+			grid.at(x, y) = normalize_cell(board[y][x]);
+		}
+	}
+	return grid;
+}
+
+Grid read_position(const Level& level) {
+	Grid grid;
+	grid.width = level.get_level_dimensions().first;
+	grid.height = level.get_level_dimensions().second;
+	grid.cells.assign(static_cast<std::size_t>(grid.width) * grid.height, ' ');
+	for (const auto& wall : level.get_walls()) {
+		grid.at(wall.first, wall.second) = '#';
+	}
+	for (const auto& goal : level.get_squares()) {
+		grid.at(goal.first, goal.second) = '.';
+	}
+	for (const auto& box : level.get_boxes()) {
+		char& cell = grid.at(box.first, box.second);
+		cell = cell == '.' ? '*' : '$';
+	}
+	// A level without a player keeps it at (-1, -1); strip_exterior copes with no player.
+	if (level.on_board(level.get_player())) {
+		char& player = grid.at(level.get_player().first, level.get_player().second);
+		player = player == '.' ? '+' : '@';
+	}
+	return grid;
+}
+
+// Drops everything the player can never interact with: floor outside the walls and
+// walls that do not touch the interior, then trims to the bounding box.
+Grid strip_exterior(const Grid& grid) {
+	std::vector<int> seeds;
+	for (int i = 0; i < static_cast<int>(grid.cells.size()); i++) {
+		if (is_player(grid.cells[i])) {
+			seeds.push_back(i);
+		}
+	}
+	if (seeds.empty()) {
+		for (int i = 0; i < static_cast<int>(grid.cells.size()); i++) {
+			if (grid.cells[i] != '#' && grid.cells[i] != ' ') {
+				seeds.push_back(i);
+			}
+		}
+	}
+	std::vector<bool> interior = flood(grid, seeds, false);
+
+	int left = grid.width, top = grid.height, right = -1, bottom = -1;
+	Grid kept = grid;
+	for (int y = 0; y < grid.height; y++) {
+		for (int x = 0; x < grid.width; x++) {
+			bool keep = interior[y * grid.width + x];
+			if (!keep && grid.at(x, y) == '#') {
+				for (int ny = std::max(0, y - 1); ny <= std::min(grid.height - 1, y + 1) && !keep; ny++) {
+					for (int nx = std::max(0, x - 1); nx <= std::min(grid.width - 1, x + 1) && !keep; nx++) {
+						keep = interior[ny * grid.width + nx];
+					}
+				}
+			}
+			if (!keep) {
+				kept.at(x, y) = ' ';
+				continue;
+			}
+			left = std::min(left, x);
+			right = std::max(right, x);
+			top = std::min(top, y);
+			bottom = std::max(bottom, y);
+		}
+	}
+
+	Grid trimmed;
+	if (right < left) {
+		return trimmed;
+	}
+	trimmed.width = right - left + 1;
+	trimmed.height = bottom - top + 1;
+	trimmed.cells.resize(static_cast<std::size_t>(trimmed.width) * trimmed.height);
+	for (int y = 0; y < trimmed.height; y++) {
+		for (int x = 0; x < trimmed.width; x++) {
+			trimmed.at(x, y) = kept.at(left + x, top + y);
+		}
+	}
+	return trimmed;
+}
+
+Grid transform(const Grid& grid, int symmetry) {
+	bool flip_x = (symmetry & 1) != 0;
+	bool flip_y = (symmetry & 2) != 0;
+	bool transpose = (symmetry & 4) != 0;
+
+	Grid result;
+	result.width = transpose ? grid.height : grid.width;
+	result.height = transpose ? grid.width : grid.height;
+	result.cells.resize(grid.cells.size());
+	for (int y = 0; y < result.height; y++) {
+		for (int x = 0; x < result.width; x++) {
+			int sx = transpose ? y : x;
+			int sy = transpose ? x : y;
+			if (flip_x) sx = grid.width - 1 - sx;
+			if (flip_y) sy = grid.height - 1 - sy;
+			result.at(x, y) = grid.at(sx, sy);
+		}
+	}
+	return result;
+}
+
+// Any cell of the player's reachable area describes the same position, so the player
+// is moved to the first one in reading order.
+void normalize_player(Grid& grid) {
+	int player = -1;
+	for (int i = 0; i < static_cast<int>(grid.cells.size()); i++) {
+		if (is_player(grid.cells[i])) {
+			player = i;
+			grid.cells[i] = grid.cells[i] == '+' ? '.' : ' ';
+			break;
+		}
+	}
+	if (player < 0) return;
+
+	std::vector<bool> reachable = flood(grid, { player }, true);
+	int first = static_cast<int>(std::find(reachable.begin(), reachable.end(), true) - reachable.begin());
+	grid.cells[first] = grid.cells[first] == '.' ? '+' : '@';
+}
+
+std::string serialize(const Grid& grid) {
+	std::string text;
+	text.reserve(grid.cells.size() + grid.height);
+	for (int y = 0; y < grid.height; y++) {
+		if (y > 0) text += '\n';
+		text.append(&grid.cells[y * grid.width], grid.width);
+	}
+	return text;
+}
+
+uint64_t rotl64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+uint64_t fmix64(uint64_t k) {
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+}
+
+std::string LevelHash::to_string() const {
+	static const char digits[] = "0123456789abcdef";
+	std::string text(32, '0');
+	for (int i = 0; i < 16; i++) {
+		text[15 - i] = digits[(high >> (4 * i)) & 0xf];
+		text[31 - i] = digits[(low >> (4 * i)) & 0xf];
+	}
+	return text;
+}
+
+// MurmurHash3 x64 128-bit.
+LevelHash hash128(const void* data, std::size_t size, uint64_t seed) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+	uint64_t h1 = seed;
+	uint64_t h2 = seed;
+
+	std::size_t blocks = size / 16;
+	for (std::size_t i = 0; i < blocks; i++) {
+		uint64_t k1, k2;
+		std::memcpy(&k1, bytes + i * 16, sizeof(k1));
+		std::memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const uint8_t* tail = bytes + blocks * 16;
+	std::size_t rest = size & 15;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+	for (std::size_t i = rest; i > 8; i--) {
+		k2 ^= static_cast<uint64_t>(tail[i - 1]) << (8 * (i - 9));
+	}
+	if (rest > 8) {
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+	for (std::size_t i = std::min<std::size_t>(rest, 8); i > 0; i--) {
+		k1 ^= static_cast<uint64_t>(tail[i - 1]) << (8 * (i - 1));
+	}
+	if (rest > 0) {
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= size;
+	h2 ^= size;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+
+	LevelHash hash;
+	hash.high = h1;
+	hash.low = h2;
+	return hash;
+}
+
+CanonicalLevel canonicalize(const Level& level) {
+	Grid base = strip_exterior(read_grid(level));
+
+	CanonicalLevel best;
+	std::string best_key;
+	for (int symmetry = 0; symmetry < 8; symmetry++) {
+		Grid candidate = transform(base, symmetry);
+		normalize_player(candidate);
+		std::string cells = serialize(candidate);
+		std::string key = std::to_string(candidate.width) + "x" + std::to_string(candidate.height) + "\n" + cells;
+		if (symmetry == 0 || key < best_key) {
+			best_key = key;
+			best.width = candidate.width;
+			best.height = candidate.height;
+			best.cells = cells;
+		}
+	}
+	best.hash = hash128(best_key.data(), best_key.size());
+	return best;
+}
+
+
+LevelHash content_hash(const Level& level) {
+	Grid grid = strip_exterior(read_position(level));
+	std::string key = std::to_string(grid.width) + "x" + std::to_string(grid.height) + "\n" + serialize(grid);
+	return hash128(key.data(), key.size(), 1);
+}
\ No newline at end of file
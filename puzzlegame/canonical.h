@@ -0,0 +1,43 @@
+#ifndef CANONICAL_H_
+#define CANONICAL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+class Level;
+
+struct LevelHash {
+	uint64_t high = 0;
+	uint64_t low = 0;
+
+	bool operator==(const LevelHash& other) const { return high == other.high && low == other.low; }
+	bool operator!=(const LevelHash& other) const { return !(*this == other); }
+	bool operator<(const LevelHash& other) const { return high != other.high ? high < other.high : low < other.low; }
+
+	std::string to_string() const;
+};
+
+struct LevelHashHasher {
+	std::size_t operator()(const LevelHash& hash) const { return static_cast<std::size_t>(hash.low ^ (hash.high * 0x9e3779b97f4a7c15ULL)); }
+};
+
+// Normalized form of a level: decorative walls and outside floor removed, trimmed to the
+// bounding box, player moved to the first cell of its reachable area and the smallest
+// of the 8 rotations/mirrors chosen. Rows are stored as XSB text separated by '\n'.
+struct CanonicalLevel {
+	int width = 0;
+	int height = 0;
+	std::string cells;
+	LevelHash hash;
+};
+
+LevelHash hash128(const void* data, std::size_t size, uint64_t seed = 0);
+
+CanonicalLevel canonicalize(const Level& level);
+
+// Hash of the level's current position exactly as laid out, without symmetry or player
+// normalization, so stored move sequences stay valid for it.
+LevelHash content_hash(const Level& level);
+
+#endif
@@ -0,0 +1,242 @@
+#include "deadlock.h"
+#include "level.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int window_cells = DeadlockDatabase::window_size * DeadlockDatabase::window_size;
+
+uint32_t cell_at(uint32_t key, int x, int y) {
+	return (key >> (2 * (y * DeadlockDatabase::window_size + x))) & 3u;
+}
+
+bool inside_window(int x, int y) {
+	return x >= 0 && y >= 0 && x < DeadlockDatabase::window_size && y < DeadlockDatabase::window_size;
+}
+
+bool is_frozen_box(uint32_t key, int x, int y, uint32_t visited);
+
+// Cells outside the window are treated as floor, so a pattern only counts as frozen
+// when the window alone proves it. Boxes already on the freeze path act as walls.
+bool blocks_axis(uint32_t key, int x, int y, uint32_t visited) {
+	if (!inside_window(x, y)) {
+		return false;
+	}
+	uint32_t cell = cell_at(key, x, y);
+	if (cell == DeadlockDatabase::Wall) {
+		return true;
+	}
+	if (cell == DeadlockDatabase::Floor) {
+		return false;
+	}
+	if (visited & (1u << (y * DeadlockDatabase::window_size + x))) {
+		return true;
+	}
+	return is_frozen_box(key, x, y, visited);
+}
+
+bool is_frozen_box(uint32_t key, int x, int y, uint32_t visited) {
+	visited |= 1u << (y * DeadlockDatabase::window_size + x);
+	bool horizontal = blocks_axis(key, x - 1, y, visited) || blocks_axis(key, x + 1, y, visited);
+	if (!horizontal) {
+		return false;
+	}
+	return blocks_axis(key, x, y - 1, visited) || blocks_axis(key, x, y + 1, visited);
+}
+
+}
+
+DeadlockDatabase::DeadlockDatabase(const std::string& path) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open deadlock database: " + path);
+	}
+	file_handle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(Header))) {
+		unmap();
+		throw std::runtime_error("Deadlock database is truncated: " + path);
+	}
+	view_size = static_cast<std::size_t>(size.QuadPart);
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		unmap();
+		throw std::runtime_error("Failed to map deadlock database: " + path);
+	}
+	mapping_handle = mapping;
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		unmap();
+		throw std::runtime_error("Failed to map deadlock database: " + path);
+	}
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open deadlock database: " + path);
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+		close(fd);
+		throw std::runtime_error("Deadlock database is truncated: " + path);
+	}
+	view_size = static_cast<std::size_t>(info.st_size);
+	void* mapped = mmap(nullptr, view_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Failed to map deadlock database: " + path);
+	}
+	view = mapped;
+#endif
+
+	const Header* header = static_cast<const Header*>(view);
+	if (header->magic != magic || header->version != version || header->window_size != window_size) {
+		unmap();
+		throw std::runtime_error("Unsupported deadlock database format: " + path);
+	}
+	if (view_size < sizeof(Header) + static_cast<std::size_t>(header->count) * sizeof(uint32_t)) {
+		unmap();
+		throw std::runtime_error("Deadlock database is truncated: " + path);
+	}
+	count = header->count;
+	patterns = reinterpret_cast<const uint32_t*>(header + 1);
+}
+
+DeadlockDatabase::~DeadlockDatabase() {
+	unmap();
+}
+
+void DeadlockDatabase::unmap() {
+#ifdef _WIN32
+	if (view) {
+		UnmapViewOfFile(view);
+	}
+	if (mapping_handle) {
+		CloseHandle(static_cast<HANDLE>(mapping_handle));
+	}
+	if (file_handle) {
+		CloseHandle(static_cast<HANDLE>(file_handle));
+	}
+#else
+	if (view) {
+		munmap(const_cast<void*>(view), view_size);
+	}
+#endif
+	view = nullptr;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	patterns = nullptr;
+	count = 0;
+}
+
+bool DeadlockDatabase::is_frozen_pattern(uint32_t key) {
+	for (int y = 0; y < window_size; y++) {
+		for (int x = 0; x < window_size; x++) {
+			if (cell_at(key, x, y) == Box && is_frozen_box(key, x, y, 0)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+std::size_t DeadlockDatabase::generate(const std::string& path) {
+	std::vector<uint32_t> keys;
+	const uint32_t key_count = 1u << (2 * window_cells);
+	for (uint32_t key = 0; key < key_count; key++) {
+		if (is_frozen_pattern(key)) {
+			keys.push_back(key);
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to create deadlock database: " + path);
+	}
+	Header header = { magic, version, window_size, static_cast<uint32_t>(keys.size()) };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(uint32_t));
+	if (!file.good()) {
+		throw std::runtime_error("Failed to write deadlock database: " + path);
+	}
+	return keys.size();
+}
+
+uint32_t DeadlockDatabase::window_key(const Level& level, int left, int top) {
+	auto dimensions = level.get_level_dimensions();
+	uint32_t key = 0;
+	for (int y = 0; y < window_size; y++) {
+		for (int x = 0; x < window_size; x++) {
+			std::pair<int, int> pos = std::make_pair(left + x, top + y);
+			uint32_t cell = Floor;
+			if (pos.first < 0 || pos.second < 0 || pos.first >= dimensions.first || pos.second >= dimensions.second) {
+				cell = Wall;
+			}
+			else if (level.check_walls_pos(pos)) {
+				cell = Wall;
+			}
+			else if (level.check_boxes_pos(pos)) {
+				cell = level.check_squares_pos(pos) ? BoxOnGoal : Box;
+			}
+			key |= cell << (2 * (y * window_size + x));
+		}
+	}
+	return key;
+}
+
+uint32_t DeadlockDatabase::window_key(const uint8_t* cells, int width, int height, int left, int top) {
+	uint32_t key = 0;
+	for (int y = 0; y < window_size; y++) {
+		for (int x = 0; x < window_size; x++) {
+			int cx = left + x;
+			int cy = top + y;
+			uint32_t cell = Wall;
+			if (cx >= 0 && cy >= 0 && cx < width && cy < height) {
+				cell = cells[cy * width + cx];
+			}
+			key |= cell << (2 * (y * window_size + x));
+		}
+	}
+	return key;
+}
+
+bool DeadlockDatabase::contains(uint32_t key) const {
+	return std::binary_search(patterns, patterns + count, key);
+}
+
+bool DeadlockDatabase::is_deadlocked(const Level& level, std::pair<int, int> box) const {
+	for (int top = box.second - window_size + 1; top <= box.second; top++) {
+		for (int left = box.first - window_size + 1; left <= box.first; left++) {
+			if (contains(window_key(level, left, top))) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool DeadlockDatabase::is_deadlocked(const uint8_t* cells, int width, int height, std::pair<int, int> box) const {
+	for (int top = box.second - window_size + 1; top <= box.second; top++) {
+		for (int left = box.first - window_size + 1; left <= box.first; left++) {
+			if (contains(window_key(cells, width, height, left, top))) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
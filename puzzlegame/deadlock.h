@@ -0,0 +1,56 @@
+#ifndef DEADLOCK_H_
+#define DEADLOCK_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+class Level;
+
+// Sorted table of 3x3 box/wall windows that contain a frozen box off its goal.
+// The table file is generated offline and mapped read-only, so every process that
+// opens the same file shares its pages through the OS file cache.
+class DeadlockDatabase {
+public:
+	static const int window_size = 3;
+	static const uint32_t magic = 0x4c444b53; // "SKDL"
+	static const uint32_t version = 1;
+
+	enum Cell : uint32_t { Floor = 0, Wall = 1, Box = 2, BoxOnGoal = 3 };
+
+	explicit DeadlockDatabase(const std::string& path);
+	~DeadlockDatabase();
+
+	DeadlockDatabase(const DeadlockDatabase&) = delete;
+	DeadlockDatabase& operator=(const DeadlockDatabase&) = delete;
+
+	static std::size_t generate(const std::string& path);
+	static bool is_frozen_pattern(uint32_t key);
+	static uint32_t window_key(const Level& level, int left, int top);
+	static uint32_t window_key(const uint8_t* cells, int width, int height, int left, int top);
+
+	bool contains(uint32_t key) const;
+	bool is_deadlocked(const Level& level, std::pair<int, int> box) const;
+	bool is_deadlocked(const uint8_t* cells, int width, int height, std::pair<int, int> box) const;
+	std::size_t size() const { return count; }
+
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t window_size;
+		uint32_t count;
+	};
+
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+	const void* view = nullptr;
+	std::size_t view_size = 0;
+
+	const uint32_t* patterns = nullptr;
+	std::size_t count = 0;
+
+	void unmap();
+};
+
+#endif
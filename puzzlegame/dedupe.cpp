@@ -0,0 +1,98 @@
+#include "dedupe.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+LevelDeduplicator::LevelDeduplicator(Loader loader, unsigned threads)
+	: loader(std::move(loader)), threads(std::max(1u, threads)) {}
+
+std::vector<LevelHash> LevelDeduplicator::hash_levels(const std::vector<Level>& levels) const {
+	std::vector<LevelHash> hashes(levels.size());
+	std::atomic<std::size_t> next(0);
+	auto worker = [&]() {
+		for (std::size_t i = next++; i < levels.size(); i = next++) {
+			hashes[i] = canonicalize(levels[i]).hash;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	unsigned count = static_cast<unsigned>(std::min<std::size_t>(threads, levels.size()));
+	for (unsigned i = 1; i < count; i++) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : pool) {
+		thread.join();
+	}
+	return hashes;
+}
+
+void LevelDeduplicator::grow() {
+	std::vector<Slot> old(index.empty() ? 4096 : index.size() * 2, Slot{ LevelHash(), { empty_file, 0 } });
+	old.swap(index);
+	std::size_t mask = index.size() - 1;
+	for (const Slot& slot : old) {
+		if (slot.origin.file == empty_file) continue;
+		std::size_t i = LevelHashHasher()(slot.hash) & mask;
+		while (index[i].origin.file != empty_file) i = (i + 1) & mask;
+		index[i] = slot;
+	}
+}
+
+const LevelDeduplicator::Origin* LevelDeduplicator::insert(const LevelHash& hash, Origin origin) {
+	if ((index_size + 1) * 4 > index.size() * 3) {
+		grow();
+	}
+	std::size_t mask = index.size() - 1;
+	std::size_t i = LevelHashHasher()(hash) & mask;
+	for (; index[i].origin.file != empty_file; i = (i + 1) & mask) {
+		if (index[i].hash == hash) {
+			return &index[i].origin;
+		}
+	}
+	index[i] = Slot{ hash, origin };
+	index_size++;
+	return nullptr;
+}
+
+DedupeStats LevelDeduplicator::run(const std::vector<std::string>& files, std::ostream& report) {
+	auto start = std::chrono::steady_clock::now();
+	DedupeStats stats;
+
+	for (std::size_t f = 0; f < files.size(); f++) {
+		std::unique_ptr<LevelSource> source = loader(files[f]);
+		stats.files++;
+
+		std::size_t position = 0;
+		std::vector<Level> levels;
+		for (bool more = true; more;) {
+			levels.clear();
+			while (levels.size() < batch_size) {
+				std::optional<Level> level = source->next();
+				if (!level) {
+					more = false;
+					break;
+				}
+				levels.push_back(std::move(*level));
+			}
+			std::vector<LevelHash> hashes = hash_levels(levels);
+
+			for (std::size_t i = 0; i < hashes.size(); i++, position++) {
+				stats.levels++;
+				Origin origin = { static_cast<uint32_t>(f), static_cast<uint32_t>(position) };
+				const Origin* first = insert(hashes[i], origin);
+				if (!first) {
+					stats.unique++;
+					continue;
+				}
+				stats.duplicates++;
+				report << files[f] << "#" << (position + 1) << " (" << levels[i].get_title() << ") duplicates "
+					<< files[first->file] << "#" << (first->level + 1) << " " << hashes[i].to_string() << '\n';
+			}
+		}
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
@@ -0,0 +1,59 @@
+#ifndef DEDUPE_H_
+#define DEDUPE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "canonical.h"
+#include "level.h"
+#include "level_source.h"
+
+struct DedupeStats {
+	std::size_t files = 0;
+	std::size_t levels = 0;
+	std::size_t unique = 0;
+	std::size_t duplicates = 0;
+	double seconds = 0.0;
+};
+
+// Indexes the canonical hash of every level across a list of files in a single pass.
+// Levels are streamed and hashed in fixed-size batches, so only one batch is held at a
+// time. The index is an open-addressing table of 24-byte slots kept between 3/8 and 3/4
+// full, so it costs 32 to 64 bytes per unique level.
+class LevelDeduplicator {
+public:
+	using Loader = std::function<std::unique_ptr<LevelSource>(const std::string&)>;
+	static const std::size_t batch_size = 4096;
+
+	LevelDeduplicator(Loader loader, unsigned threads);
+
+	DedupeStats run(const std::vector<std::string>& files, std::ostream& report);
+
+private:
+	struct Origin {
+		uint32_t file;
+		uint32_t level;
+	};
+
+	// A slot whose origin file is empty_file is free; no run scans that many files.
+	struct Slot {
+		LevelHash hash;
+		Origin origin;
+	};
+	static const uint32_t empty_file = UINT32_MAX;
+
+	Loader loader;
+	unsigned threads;
+	std::vector<Slot> index;
+	std::size_t index_size = 0;
+
+	std::vector<LevelHash> hash_levels(const std::vector<Level>& levels) const;
+	// Adds the hash with its origin and returns null, or returns the origin already stored.
+	const Origin* insert(const LevelHash& hash, Origin origin);
+	void grow();
+};
+
+#endif
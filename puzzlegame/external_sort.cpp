@@ -0,0 +1,245 @@
+#include "external_sort.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+std::size_t io_block_size(std::size_t memory_budget) {
+	return std::clamp<std::size_t>(memory_budget / 64, 64 << 10, 8 << 20);
+}
+
+RunWriter::RunWriter(const std::string& path, std::size_t buffer_bytes, ExternalStats& stats)
+	: path(path), file(path, std::ios::binary | std::ios::trunc), stats(stats) {
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to create run file: " + path);
+	}
+	buffers[0].resize(buffer_bytes);
+	buffers[1].resize(buffer_bytes);
+}
+
+RunWriter::~RunWriter() {
+	try {
+		close();
+	}
+	catch (const std::exception&) {
+	}
+}
+
+void RunWriter::write(const uint8_t* record, std::size_t size) {
+	if (used + size > buffers[active].size()) {
+		flush();
+	}
+	std::memcpy(buffers[active].data() + used, record, size);
+	used += size;
+}
+
+void RunWriter::flush() {
+	if (pending.valid()) {
+		pending.get();
+	}
+	if (used == 0) {
+		return;
+	}
+	const uint8_t* data = buffers[active].data();
+	std::size_t size = used;
+	pending = std::async(std::launch::async, [this, data, size]() {
+		file.write(reinterpret_cast<const char*>(data), size);
+		if (!file) {
+			throw std::runtime_error("Failed to write run file: " + path);
+		}
+	});
+	stats.bytes_written += size;
+	active ^= 1;
+	used = 0;
+}
+
+void RunWriter::close() {
+	if (!file.is_open()) {
+		return;
+	}
+	flush();
+	if (pending.valid()) {
+		pending.get();
+	}
+	file.close();
+}
+
+RunReader::RunReader(const std::string& path, std::size_t record_size, std::size_t buffer_bytes, ExternalStats& stats)
+	: path(path), file(path, std::ios::binary), record_size(record_size), stats(stats) {
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open run file: " + path);
+	}
+	std::size_t block = std::max(record_size, buffer_bytes / record_size * record_size);
+	buffers[0].resize(block);
+	buffers[1].resize(block);
+	prefetch();
+}
+
+RunReader::~RunReader() {
+	if (pending.valid()) {
+		pending.wait();
+	}
+}
+
+void RunReader::prefetch() {
+	std::vector<uint8_t>& buffer = buffers[active ^ 1];
+	pending = std::async(std::launch::async, [this, &buffer]() {
+		file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+		return static_cast<std::size_t>(file.gcount());
+	});
+}
+
+const uint8_t* RunReader::next() {
+	if (position + record_size > filled) {
+		if (!pending.valid()) {
+			return nullptr;
+		}
+		filled = pending.get();
+		position = 0;
+		active ^= 1;
+		stats.bytes_read += filled;
+		if (filled < record_size) {
+			return nullptr;
+		}
+		if (filled == buffers[active].size()) {
+			prefetch();
+		}
+	}
+	const uint8_t* record = buffers[active].data() + position;
+	position += record_size;
+	return record;
+}
+
+RecordSorter::RecordSorter(const std::string& directory, std::size_t record_size, std::size_t memory_budget, ExternalStats& stats)
+	: directory(directory), record_size(record_size), io_bytes(io_block_size(memory_budget)), stats(stats) {
+	// The writer's two buffers come out of the budget, the rest holds records and their sort order.
+	std::size_t available = memory_budget > 4 * io_bytes ? memory_budget - 2 * io_bytes : memory_budget / 2;
+	capacity = std::max<std::size_t>(1, available / (record_size + sizeof(uint32_t)));
+	capacity = std::min<std::size_t>(capacity, UINT32_MAX);
+}
+
+void RecordSorter::add(const uint8_t* record) {
+	if (order.size() == capacity) {
+		spill();
+	}
+	// Grow by hand so small searches stay small and large ones stop at the budget.
+	if (order.size() == order.capacity()) {
+		std::size_t grown = std::min(capacity, std::max<std::size_t>(4096, order.size() * 2));
+		order.reserve(grown);
+		records.reserve(grown * record_size);
+	}
+	order.push_back(static_cast<uint32_t>(order.size()));
+	records.insert(records.end(), record, record + record_size);
+}
+
+void RecordSorter::spill() {
+	if (order.empty()) {
+		return;
+	}
+	const uint8_t* base = records.data();
+	std::size_t size = record_size;
+	std::sort(order.begin(), order.end(), [base, size](uint32_t a, uint32_t b) {
+		return std::memcmp(base + a * size, base + b * size, size) < 0;
+	});
+
+	std::string path = directory + "/run-" + std::to_string(stats.runs++);
+	RunWriter writer(path, io_bytes, stats);
+	const uint8_t* last = nullptr;
+	for (uint32_t index : order) {
+		const uint8_t* record = base + static_cast<std::size_t>(index) * size;
+		if (last && std::memcmp(last, record, size) == 0) {
+			continue;
+		}
+		writer.write(record, size);
+		last = record;
+	}
+	writer.close();
+	runs.push_back(path);
+	records.clear();
+	order.clear();
+}
+
+std::vector<std::string> RecordSorter::finish() {
+	spill();
+	std::vector<std::string> result;
+	result.swap(runs);
+	return result;
+}
+
+namespace {
+
+// Every reader double buffers, so a merge needs two blocks per input.
+const std::size_t min_merge_block = 64 << 10;
+const std::size_t max_fan_in = 256;
+
+void merge_group(const std::vector<std::string>& runs, std::size_t record_size, std::size_t block,
+	ExternalStats& stats, const std::function<void(const uint8_t*)>& emit) {
+	std::vector<std::unique_ptr<RunReader>> readers;
+	std::vector<const uint8_t*> heads;
+	for (const auto& run : runs) {
+		readers.push_back(std::make_unique<RunReader>(run, record_size, block, stats));
+		heads.push_back(readers.back()->next());
+	}
+
+	auto greater = [&heads, record_size](std::size_t a, std::size_t b) {
+		return std::memcmp(heads[a], heads[b], record_size) > 0;
+	};
+	std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> queue(greater);
+	for (std::size_t i = 0; i < heads.size(); i++) {
+		if (heads[i]) queue.push(i);
+	}
+
+	std::vector<uint8_t> last(record_size);
+	bool any = false;
+	while (!queue.empty()) {
+		std::size_t i = queue.top();
+		queue.pop();
+		if (!any || std::memcmp(last.data(), heads[i], record_size) != 0) {
+			std::memcpy(last.data(), heads[i], record_size);
+			any = true;
+			emit(last.data());
+		}
+		heads[i] = readers[i]->next();
+		if (heads[i]) queue.push(i);
+	}
+}
+
+}
+
+// More runs than the budget or the open file limit allow are merged in several passes;
+// the intermediate runs are removed again.
+void merge_runs(const std::vector<std::string>& runs, std::size_t record_size, std::size_t memory_budget,
+	ExternalStats& stats, const std::function<void(const uint8_t*)>& emit) {
+	std::size_t fan_in = std::clamp<std::size_t>(memory_budget / (2 * min_merge_block), 2, max_fan_in);
+	std::size_t block = std::min(io_block_size(memory_budget), memory_budget / (2 * fan_in));
+	block = std::max(block, min_merge_block);
+
+	std::vector<std::string> inputs = runs;
+	std::vector<std::string> intermediates;
+	for (int pass = 1; inputs.size() > fan_in; pass++) {
+		std::vector<std::string> outputs;
+		for (std::size_t first = 0; first < inputs.size(); first += fan_in) {
+			std::vector<std::string> group(inputs.begin() + first, inputs.begin() + std::min(inputs.size(), first + fan_in));
+			if (group.size() == 1) {
+				outputs.push_back(group.front());
+				continue;
+			}
+			std::string path = group.front() + "-" + std::to_string(pass);
+			RunWriter writer(path, block, stats);
+			merge_group(group, record_size, block, stats, [&writer, record_size](const uint8_t* record) {
+				writer.write(record, record_size);
+			});
+			writer.close();
+			outputs.push_back(path);
+			intermediates.push_back(path);
+			stats.runs++;
+		}
+		inputs.swap(outputs);
+	}
+	merge_group(inputs, record_size, block, stats, emit);
+	for (const auto& path : intermediates) {
+		std::remove(path.c_str());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef EXTERNAL_SORT_H_
+#define EXTERNAL_SORT_H_
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+// Disk traffic of one external search.
+struct ExternalStats {
+	uint64_t bytes_written = 0;
+	uint64_t bytes_read = 0;
+	uint32_t runs = 0;
+};
+
+// Appends records to a file. Records are gathered in one buffer while the other is
+// written by a background task, so the caller only waits when the disk falls behind.
+class RunWriter {
+public:
+	RunWriter(const std::string& path, std::size_t buffer_bytes, ExternalStats& stats);
+	~RunWriter();
+
+	RunWriter(const RunWriter&) = delete;
+	RunWriter& operator=(const RunWriter&) = delete;
+
+	void write(const uint8_t* record, std::size_t size);
+	// Flushes and closes the file; write errors surface here as exceptions.
+	void close();
+
+private:
+	std::string path;
+	std::ofstream file;
+	std::vector<uint8_t> buffers[2];
+	int active = 0;
+	std::size_t used = 0;
+	std::future<void> pending;
+	ExternalStats& stats;
+
+	void flush();
+};
+
+// Reads fixed-size records of a file, prefetching the next block in the background
+// while the current one is consumed.
+class RunReader {
+public:
+	RunReader(const std::string& path, std::size_t record_size, std::size_t buffer_bytes, ExternalStats& stats);
+	~RunReader();
+
+	RunReader(const RunReader&) = delete;
+	RunReader& operator=(const RunReader&) = delete;
+
+	// Next record, or nullptr at the end of the file.
+	const uint8_t* next();
+
+private:
+	std::string path;
+	std::ifstream file;
+	std::size_t record_size;
+	std::vector<uint8_t> buffers[2];
+	int active = 0;
+	std::size_t filled = 0;
+	std::size_t position = 0;
+	std::future<std::size_t> pending;
+	ExternalStats& stats;
+
+	void prefetch();
+};
+
+// Collects fixed-size records in memory and spills them as sorted, duplicate-free run
+// files whenever the budget is used up. Records compare as byte strings.
+class RecordSorter {
+public:
+	RecordSorter(const std::string& directory, std::size_t record_size, std::size_t memory_budget, ExternalStats& stats);
+
+	void add(const uint8_t* record);
+	// Spills what is left and returns the run files written since the last call.
+	std::vector<std::string> finish();
+
+	std::size_t get_record_size() const { return record_size; }
+
+private:
+	std::string directory;
+	std::size_t record_size;
+	std::size_t capacity;
+	std::size_t io_bytes;
+	std::vector<uint8_t> records;
+	std::vector<uint32_t> order;
+	std::vector<std::string> runs;
+	ExternalStats& stats;
+
+	void spill();
+};
+
+// K-way merges sorted run files and calls emit once per distinct record, in order.
+void merge_runs(const std::vector<std::string>& runs, std::size_t record_size, std::size_t memory_budget,
+	ExternalStats& stats, const std::function<void(const uint8_t*)>& emit);
+
+// Block size for sequential I/O under a memory budget.
+std::size_t io_block_size(std::size_t memory_budget);
+
+#endif
\ No newline at end of file
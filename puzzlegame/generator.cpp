@@ -0,0 +1,364 @@
+#include "generator.h"
+#include "level_source.h"
+#include "solver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const char* const templates[][3] = {
+	{ "   ", "   ", "   " },
+	{ "#  ", "   ", "   " },
+	{ "## ", "   ", "   " },
+	{ "###", "   ", "   " },
+	{ "###", "#  ", "#  " },
+	{ " # ", "   ", "   " },
+	{ "   ", " # ", "   " },
+	{ "#  ", "## ", "   " },
+	{ " # ", " # ", "   " },
+	{ "   ", " ##", " # " },
+	{ "#  ", "   ", "  #" },
+	{ "## ", "#  ", "   " },
+};
+
+const int template_count = sizeof(templates) / sizeof(templates[0]);
+
+struct Room {
+	int width = 0;
+	int height = 0;
+	std::vector<char> cells;
+
+	char& at(int x, int y) { return cells[y * width + x]; }
+};
+
+bool is_open(char cell) {
+	return cell != '#';
+}
+
+bool has_box(char cell) {
+	return cell == '$' || cell == '*';
+}
+
+std::vector<int> flood(const Room& room, int from, bool boxes_block) {
+	std::vector<int> area;
+	std::vector<bool> seen(room.cells.size(), false);
+	const int offsets[4] = { -1, 1, -room.width, room.width };
+	area.push_back(from);
+	seen[from] = true;
+	for (std::size_t i = 0; i < area.size(); i++) {
+		for (int d = 0; d < 4; d++) {
+			int next = area[i] + offsets[d];
+			char cell = room.cells[next];
+			if (seen[next] || !is_open(cell) || (boxes_block && has_box(cell))) continue;
+			seen[next] = true;
+			area.push_back(next);
+		}
+	}
+	return area;
+}
+
+// Stitches randomly rotated and mirrored 3x3 templates inside a wall border and keeps only
+// the largest connected floor area.
+Room build_room(const GeneratorOptions& options, std::mt19937_64& rng) {
+	int blocks_x = std::max(1, (options.width - 2) / 3);
+	int blocks_y = std::max(1, (options.height - 2) / 3);
+	Room room;
+	room.width = blocks_x * 3 + 2;
+	room.height = blocks_y * 3 + 2;
+	room.cells.assign(static_cast<std::size_t>(room.width) * room.height, '#');
+
+	std::uniform_int_distribution<int> pick_template(0, template_count - 1);
+	std::uniform_int_distribution<int> pick_rotation(0, 7);
+	for (int by = 0; by < blocks_y; by++) {
+		for (int bx = 0; bx < blocks_x; bx++) {
+			int t = pick_template(rng);
+			int rotation = pick_rotation(rng);
+			for (int y = 0; y < 3; y++) {
+				for (int x = 0; x < 3; x++) {
+					int sx = (rotation & 4) ? y : x;
+					int sy = (rotation & 4) ? x : y;
+					if (rotation & 1) sx = 2 - sx;
+					if (rotation & 2) sy = 2 - sy;
+					room.at(1 + bx * 3 + x, 1 + by * 3 + y) = templates[t][sy][sx];
+				}
+			}
+		}
+	}
+
+	std::vector<int> largest;
+	std::vector<bool> visited(room.cells.size(), false);
+	for (int i = 0; i < static_cast<int>(room.cells.size()); i++) {
+		if (visited[i] || !is_open(room.cells[i])) continue;
+		std::vector<int> area = flood(room, i, false);
+		for (int cell : area) visited[cell] = true;
+		if (area.size() > largest.size()) largest = area;
+	}
+	std::vector<char> cells(room.cells.size(), '#');
+	for (int cell : largest) cells[cell] = ' ';
+	room.cells = cells;
+	return room;
+}
+
+std::vector<int> floor_cells(const Room& room) {
+	std::vector<int> cells;
+	for (int i = 0; i < static_cast<int>(room.cells.size()); i++) {
+		if (room.cells[i] == ' ') cells.push_back(i);
+	}
+	return cells;
+}
+
+// Starts with every box on its goal and applies random pulls, which are pushes played
+// backwards, so the result is always solvable.
+bool place_reverse(Room& room, int boxes, std::mt19937_64& rng) {
+	std::vector<int> floor = floor_cells(room);
+	if (static_cast<int>(floor.size()) < boxes * 3 + 2) return false;
+	std::shuffle(floor.begin(), floor.end(), rng);
+	for (int i = 0; i < boxes; i++) room.cells[floor[i]] = '*';
+	int player = floor[boxes];
+
+	const int offsets[4] = { -1, 1, -room.width, room.width };
+	int pulls = boxes * 20;
+	for (int i = 0; i < pulls; i++) {
+		std::vector<int> area = flood(room, player, true);
+		std::vector<bool> reachable(room.cells.size(), false);
+		for (int cell : area) reachable[cell] = true;
+
+		std::vector<std::pair<int, int>> moves;
+		for (int cell = 0; cell < static_cast<int>(room.cells.size()); cell++) {
+			if (!has_box(room.cells[cell])) continue;
+			for (int d = 0; d < 4; d++) {
+				int stand = cell + offsets[d];
+				int retreat = stand + offsets[d];
+				if (!reachable[stand] || retreat < 0 || retreat >= static_cast<int>(room.cells.size())) continue;
+				if (!is_open(room.cells[retreat]) || has_box(room.cells[retreat])) continue;
+				moves.push_back(std::make_pair(cell, d));
+			}
+		}
+		if (moves.empty()) break;
+
+		auto move = moves[std::uniform_int_distribution<std::size_t>(0, moves.size() - 1)(rng)];
+		int from = move.first;
+		int to = from + offsets[move.second];
+		room.cells[from] = room.cells[from] == '*' ? '.' : ' ';
+		room.cells[to] = room.cells[to] == '.' ? '*' : '$';
+		player = to + offsets[move.second];
+	}
+
+	if (std::count(room.cells.begin(), room.cells.end(), '$') == 0) return false;
+	room.cells[player] = room.cells[player] == '.' ? '+' : '@';
+	return true;
+}
+
+bool place_random(Room& room, int boxes, std::mt19937_64& rng) {
+	std::vector<int> floor = floor_cells(room);
+	if (static_cast<int>(floor.size()) < boxes * 3 + 2) return false;
+	std::shuffle(floor.begin(), floor.end(), rng);
+	for (int i = 0; i < boxes; i++) room.cells[floor[i]] = '.';
+	for (int i = boxes; i < boxes * 2; i++) room.cells[floor[i]] = '$';
+	room.cells[floor[boxes * 2]] = '@';
+	return true;
+}
+
+// Walls that do not touch the interior are dropped so the level reads like a hand made one.
+std::string to_level_data(const Room& room) {
+	std::string data;
+	for (int y = 0; y < room.height; y++) {
+		std::string row;
+		for (int x = 0; x < room.width; x++) {
+			char cell = room.cells[y * room.width + x];
+			if (cell == '#') {
+				bool touches = false;
+				for (int ny = std::max(0, y - 1); ny <= std::min(room.height - 1, y + 1); ny++) {
+					for (int nx = std::max(0, x - 1); nx <= std::min(room.width - 1, x + 1); nx++) {
+						touches = touches || room.cells[ny * room.width + nx] != '#';
+					}
+				}
+				cell = touches ? '#' : ' ';
+			}
+			row += cell;
+		}
+		row.erase(row.find_last_not_of(' ') + 1);
+		data += row + '\n';
+	}
+	return data;
+}
+
+// Escapes text for XML character data and quoted attribute values.
+std::string xml_escape(const std::string& text) {
+	std::string escaped;
+	escaped.reserve(text.size());
+	for (char c : text) {
+		switch (c) {
+		case '&':
+			escaped += "&amp;";
+			break;
+		case '<':
+			escaped += "&lt;";
+			break;
+		case '>':
+			escaped += "&gt;";
+			break;
+		case '"':
+			escaped += "&quot;";
+			break;
+		case '\'':
+			escaped += "&apos;";
+			break;
+		default:
+			escaped += c;
+			break;
+		}
+	}
+	return escaped;
+}
+
+}
+
+LevelGenerator::LevelGenerator(const GeneratorOptions& options) : options(options) {}
+
+std::vector<GeneratedLevel> LevelGenerator::run() {
+	auto start = std::chrono::steady_clock::now();
+	stats = GeneratorStats();
+	std::vector<GeneratedLevel> levels;
+	std::mutex levels_mutex;
+	std::atomic<int> accepted(0);
+	std::atomic<uint64_t> candidates(0);
+	std::atomic<uint64_t> rejected(0);
+
+	auto worker = [&](unsigned index) {
+		std::mt19937_64 rng(options.seed * 0x9e3779b97f4a7c15ULL + index);
+		while (accepted.load() < options.count) {
+			candidates++;
+			Room room = build_room(options, rng);
+			bool placed = options.method == GeneratorMethod::ReversePlay
+				? place_reverse(room, options.boxes, rng)
+				: place_random(room, options.boxes, rng);
+			if (!placed) {
+				rejected++;
+				continue;
+			}
+
+			Level level(to_level_data(room));
+			SolverOptions solver_options;
+			solver_options.deadlocks = options.deadlocks;
+			solver_options.max_nodes = options.max_nodes;
+			Solver solver(level, solver_options);
+			Solution solution = solver.solve();
+			if (!solution.solved || solution.pushes < options.min_pushes) {
+				rejected++;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(levels_mutex);
+			if (static_cast<int>(levels.size()) < options.count) {
+				const SolverStats& solved = solver.get_stats();
+				levels.push_back({ level, solution.pushes, solution.moves.size(), solved.nodes_expanded, solved.seconds });
+				accepted++;
+			}
+		}
+	};
+
+	unsigned threads = std::max(1u, options.threads);
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; i++) {
+		pool.emplace_back(worker, i);
+	}
+	worker(0);
+	for (auto& thread : pool) {
+		thread.join();
+	}
+
+	stats.candidates = candidates.load();
+	stats.rejected = rejected.load();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return levels;
+}
+
+void append_slc_levels(const std::string& path, const std::vector<GeneratedLevel>& levels, const std::string& title, const std::string& id_prefix) {
+	std::string document;
+	std::ifstream existing(path, std::ios::binary);
+	if (existing.is_open()) {
+		std::stringstream buffer;
+		buffer << existing.rdbuf();
+		document = buffer.str();
+		existing.close();
+	}
+
+	// Numbers continue after the levels already in the file, skipping Ids that are taken.
+	std::set<std::string> taken;
+	std::size_t number = 0;
+	if (!document.empty()) {
+		SlcSource source(ByteReader(std::make_unique<MemoryStream>(document.data(), document.data() + document.size())), false);
+		while (std::optional<Level> level = source.next()) {
+			taken.insert(level->get_title());
+			number++;
+		}
+	}
+
+	std::ostringstream elements;
+	for (const auto& generated : levels) {
+		std::string id;
+		do {
+			id = id_prefix + std::to_string(++number);
+		} while (taken.count(id));
+		const auto& board = generated.level.get_board();
+		std::size_t width = 0;
+		for (const auto& row : board) width = std::max(width, row.size());
+		// The solver's rating goes in attributes of its own, so Copyright stays free for its purpose.
+		elements << "    <Level Id=\"" << xml_escape(id) << "\" Width=\"" << width << "\" Height=\"" << board.size()
+			<< "\" Pushes=\"" << generated.pushes << "\" Moves=\"" << generated.moves << "\" Nodes=\"" << generated.nodes << "\">\n";
+		for (const auto& row : board) {
+			elements << "      <L>" << xml_escape(std::string(row.begin(), row.end())) << "</L>\n";
+		}
+		elements << "    </Level>\n";
+	}
+
+	if (document.empty()) {
+		document = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+			"<SokobanLevels xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:schemaLocation=\"SokobanLev.xsd\">\n"
+			"  <Title>" + xml_escape(title) + "</Title>\n"
+			"  <LevelCollection>\n" + elements.str() +
+			"  </LevelCollection>\n"
+			"</SokobanLevels>\n";
+	}
+	else {
+		std::size_t end = document.rfind("</LevelCollection>");
+		if (end == std::string::npos) {
+			throw std::runtime_error("No LevelCollection element in " + path);
+		}
+		std::size_t line_start = document.find_last_of('\n', end);
+		line_start = line_start == std::string::npos ? 0 : line_start + 1;
+		bool own_line = document.find_first_not_of(" \t", line_start) == end;
+		document.insert(own_line ? line_start : end, elements.str());
+	}
+
+	// The pack is written beside the original and renamed over it, so a failed write
+	// leaves the user's file as it was.
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file << document;
+		file.close();
+		if (!file) {
+			std::remove(temporary.c_str());
+			throw std::runtime_error("Failed to write level file: " + temporary);
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		std::remove(temporary.c_str());
+		throw std::runtime_error("Failed to replace level file: " + path + ": " + error.message());
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "level.h"
+
+class DeadlockDatabase;
+
+enum class GeneratorMethod { ReversePlay, Templates };
+
+struct GeneratorOptions {
+	GeneratorMethod method = GeneratorMethod::ReversePlay;
+	int width = 9;
+	int height = 9;
+	int boxes = 3;
+	int count = 10;
+	int min_pushes = 8;
+	unsigned threads = 1;
+	uint64_t seed = 1;
+	uint64_t max_nodes = 200000;
+	const DeadlockDatabase* deadlocks = nullptr;
+};
+
+struct GeneratedLevel {
+	Level level;
+	int pushes;
+	std::size_t moves;
+	uint64_t nodes;
+	double seconds;
+};
+
+struct GeneratorStats {
+	uint64_t candidates = 0;
+	uint64_t rejected = 0;
+	double seconds = 0.0;
+};
+
+// Builds rooms by stitching rotated 3x3 wall templates, fills them with boxes either by
+// pulling boxes off their goals or by random placement, and keeps only candidates the
+// solver proves solvable. Candidates are built and rated on all worker threads.
+class LevelGenerator {
+public:
+	explicit LevelGenerator(const GeneratorOptions& options);
+
+	std::vector<GeneratedLevel> run();
+
+	const GeneratorStats& get_stats() const { return stats; }
+
+private:
+	GeneratorOptions options;
+	GeneratorStats stats;
+};
+
+// Adds the levels to the collection of an .slc file, creating it with this title when
+// it does not exist. Ids are id_prefix and a number continuing after the levels already
+// in the file.
+void append_slc_levels(const std::string& path, const std::vector<GeneratedLevel>& levels, const std::string& title, const std::string& id_prefix);
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef HINT_H_
+#define HINT_H_
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "canonical.h"
+#include "level.h"
+#include "solution_cache.h"
+#include "solver.h"
+
+// Runs the solver for the current level on a worker thread. The frame loop only polls
+// atomics, so it never waits on the worker; cancelled workers are joined once they
+// notice their cancel flag. Positions found in the solution cache are answered without
+// starting a worker. Searches stop after max_nodes expansions (0 = unlimited), and an
+// exception in the worker is reported as a failed hint instead of ending the game.
+class HintSolver {
+public:
+	HintSolver(const DeadlockDatabase* deadlocks, SolutionCache* cache, uint64_t max_nodes)
+		: deadlocks(deadlocks), cache(cache), max_nodes(max_nodes) {}
+
+	~HintSolver() {
+		cancel();
+		for (auto& job : retired) {
+			job->thread.join();
+		}
+	}
+
+	HintSolver(const HintSolver&) = delete;
+	HintSolver& operator=(const HintSolver&) = delete;
+
+	void start(const Level& level) {
+		cancel();
+		LevelHash hash;
+		if (cache) {
+			hash = content_hash(level);
+			CacheEntry entry;
+			// Hints promise push-optimal solutions, so macro results of the analyzer are searched again.
+			if (cache->lookup(hash, max_nodes, entry) && !(entry.solved && !entry.optimal)) {
+				set_result(entry.solved, entry.pushes, entry.moves, entry.max_nodes != 0);
+				status += " (cached)";
+				return;
+			}
+		}
+
+		auto job = std::make_unique<Job>();
+		job->hash = hash;
+		job->started = std::chrono::steady_clock::now();
+		Job* raw = job.get();
+		job->thread = std::thread([raw, level, this]() {
+			try {
+				SolverOptions options;
+				options.deadlocks = deadlocks;
+				options.cancel = &raw->cancel;
+				options.progress = &raw->nodes;
+				options.max_nodes = max_nodes;
+				Solver solver(level, options);
+				raw->solution = solver.solve();
+				raw->stats = solver.get_stats();
+			}
+			catch (const std::exception& e) {
+				raw->error = e.what();
+			}
+			raw->finished.store(true, std::memory_order_release);
+		});
+		active = std::move(job);
+		status = "hint: searching";
+	}
+
+	void cancel() {
+		if (active) {
+			active->cancel.store(true, std::memory_order_relaxed);
+			retired.push_back(std::move(active));
+		}
+		move.reset();
+		status.clear();
+	}
+
+	void poll(const Level& level) {
+		for (auto it = retired.begin(); it != retired.end();) {
+			if ((*it)->finished.load(std::memory_order_acquire)) {
+				(*it)->thread.join();
+				it = retired.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		if (!active) {
+			return;
+		}
+		if (!active->finished.load(std::memory_order_acquire)) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - active->started).count();
+			uint64_t nodes = active->nodes.load(std::memory_order_relaxed);
+			status = "hint: searching, " + std::to_string(seconds > 0.0 ? static_cast<uint64_t>(nodes / seconds) : 0) + " nodes/s";
+			return;
+		}
+
+		active->thread.join();
+		if (!active->error.empty()) {
+			std::cerr << "hint for level " << level.get_title() << " failed: " << active->error << std::endl;
+			status = "hint: failed";
+			active.reset();
+			return;
+		}
+		const Solution& solution = active->solution;
+		const SolverStats& stats = active->stats;
+		set_result(solution.solved, solution.pushes, solution.moves, max_nodes != 0 && stats.nodes_expanded > max_nodes);
+		if (cache) {
+			CacheEntry entry;
+			entry.solver_version = Solver::version;
+			entry.solved = solution.solved;
+			entry.optimal = solution.optimal;
+			entry.pushes = solution.pushes;
+			entry.max_nodes = max_nodes;
+			entry.nodes_expanded = stats.nodes_expanded;
+			entry.nodes_generated = stats.nodes_generated;
+			entry.seconds = stats.seconds;
+			entry.moves = solution.moves;
+			try {
+				cache->store(active->hash, entry);
+			}
+			catch (const std::exception& e) {
+				std::cerr << e.what() << std::endl;
+			}
+		}
+		active.reset();
+	}
+
+	const std::optional<Direction>& get_move() const { return move; }
+	const std::string& get_status() const { return status; }
+
+private:
+	void set_result(bool solved, int pushes, const std::vector<Direction>& moves, bool limited) {
+		if (solved && !moves.empty()) {
+			move = moves.front();
+			status = "hint: " + std::to_string(pushes) + " pushes left";
+		}
+		else if (solved) {
+			status = "hint: solved";
+		}
+		else {
+			status = limited ? "hint: node limit reached" : "hint: no solution";
+		}
+	}
+
+	struct Job {
+		std::atomic<bool> cancel{ false };
+		std::atomic<bool> finished{ false };
+		std::atomic<uint64_t> nodes{ 0 };
+		std::chrono::steady_clock::time_point started;
+		LevelHash hash;
+		Solution solution;
+		SolverStats stats;
+		std::string error;
+		std::thread thread;
+	};
+
+	const DeadlockDatabase* deadlocks;
+	SolutionCache* cache;
+	uint64_t max_nodes;
+	std::unique_ptr<Job> active;
+	std::vector<std::unique_ptr<Job>> retired;
+	std::optional<Direction> move;
+	std::string status;
+};
+
+#endif
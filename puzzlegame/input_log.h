@@ -0,0 +1,295 @@
+#ifndef INPUT_LOG_H_
+#define INPUT_LOG_H_
+
+#include <SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One entry of an input recording: an event the game loop reacts to, or the level it
+// switched to. Frames count iterations of the game loop; times are microseconds since the
+// recording started.
+struct InputRecord {
+	enum Kind : uint8_t { Quit = 1, Key = 2, Wheel = 3, LevelSwitch = 4 };
+
+	Kind kind = Quit;
+	uint32_t frame = 0;
+	uint64_t micros = 0;
+	// Key code, wheel steps or level index.
+	int64_t value = 0;
+	std::string title;
+};
+
+// Files start with the magic and a version byte. Each record is its kind followed by the
+// frame and time as deltas to the previous record, then its value, all as varints.
+namespace input_log {
+
+const char magic[4] = { 'P', 'G', 'I', 'N' };
+const uint8_t version = 1;
+
+inline void put_varint(std::string& out, uint64_t value) {
+	while (value >= 0x80) {
+		out += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	out += static_cast<char>(value);
+}
+
+inline bool get_varint(const std::string& in, std::size_t& position, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && position < in.size(); shift += 7) {
+		uint8_t byte = static_cast<uint8_t>(in[position++]);
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+inline int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+}
+
+// Logs the input of a play session. Only events the game reacts to are kept, so a
+// recording replays to the same levels and moves.
+class InputRecorder {
+public:
+	explicit InputRecorder(const std::string& path) : path(path), file(path, std::ios::binary | std::ios::trunc), start(std::chrono::steady_clock::now()) {
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to create input recording: " + path);
+		}
+		buffer.append(input_log::magic, sizeof(input_log::magic));
+		buffer += static_cast<char>(input_log::version);
+	}
+
+	~InputRecorder() {
+		try {
+			close();
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	InputRecorder(const InputRecorder&) = delete;
+	InputRecorder& operator=(const InputRecorder&) = delete;
+
+	void record_event(uint32_t frame, const SDL_Event& event) {
+		InputRecord record;
+		record.frame = frame;
+		if (event.type == SDL_QUIT) {
+			record.kind = InputRecord::Quit;
+		}
+		else if (event.type == SDL_KEYDOWN) {
+			record.kind = InputRecord::Key;
+			record.value = event.key.keysym.sym;
+		}
+		else if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0) {
+			record.kind = InputRecord::Wheel;
+			record.value = event.wheel.y;
+		}
+		else {
+			return;
+		}
+		append(record);
+	}
+
+	void record_level(uint32_t frame, std::size_t index, const std::string& title) {
+		InputRecord record;
+		record.kind = InputRecord::LevelSwitch;
+		record.frame = frame;
+		record.value = static_cast<int64_t>(index);
+		record.title = title;
+		append(record);
+	}
+
+	void close() {
+		if (!file.is_open()) {
+			return;
+		}
+		flush();
+		file.close();
+		if (!file) {
+			throw std::runtime_error("Failed to write input recording: " + path);
+		}
+	}
+
+private:
+	std::string path;
+	std::ofstream file;
+	std::string buffer;
+	std::chrono::steady_clock::time_point start;
+	uint32_t last_frame = 0;
+	uint64_t last_micros = 0;
+
+	void append(InputRecord& record) {
+		record.micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+		buffer += static_cast<char>(record.kind);
+		input_log::put_varint(buffer, record.frame - last_frame);
+		input_log::put_varint(buffer, record.micros - last_micros);
+		input_log::put_varint(buffer, input_log::zigzag(record.value));
+		if (record.kind == InputRecord::LevelSwitch) {
+			input_log::put_varint(buffer, record.title.size());
+			buffer += record.title;
+		}
+		last_frame = record.frame;
+		last_micros = record.micros;
+		if (buffer.size() >= 4096) {
+			flush();
+		}
+	}
+
+	void flush() {
+		file.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+};
+
+// Feeds a recording back into the game loop in place of SDL_PollEvent, either as fast as
+// the loop runs or at the recorded times, and collects frame times for a report.
+class InputReplay {
+public:
+	InputReplay(const std::string& path, bool realtime) : path(path), realtime(realtime) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open input recording: " + path);
+		}
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (data.size() < sizeof(input_log::magic) + 1 || !std::equal(input_log::magic, input_log::magic + sizeof(input_log::magic), data.begin())
+			|| static_cast<uint8_t>(data[sizeof(input_log::magic)]) != input_log::version) {
+			throw std::runtime_error("Not an input recording: " + path);
+		}
+
+		std::size_t position = sizeof(input_log::magic) + 1;
+		uint32_t frame = 0;
+		uint64_t micros = 0;
+		while (position < data.size()) {
+			InputRecord record;
+			record.kind = static_cast<InputRecord::Kind>(data[position++]);
+			uint64_t frames = 0;
+			uint64_t elapsed = 0;
+			uint64_t value = 0;
+			bool valid = record.kind >= InputRecord::Quit && record.kind <= InputRecord::LevelSwitch
+				&& input_log::get_varint(data, position, frames) && input_log::get_varint(data, position, elapsed)
+				&& input_log::get_varint(data, position, value);
+			if (valid && record.kind == InputRecord::LevelSwitch) {
+				uint64_t length = 0;
+				valid = input_log::get_varint(data, position, length) && length <= data.size() - position;
+				if (valid) {
+					record.title = data.substr(position, static_cast<std::size_t>(length));
+					position += static_cast<std::size_t>(length);
+				}
+			}
+			if (!valid) {
+				throw std::runtime_error("Corrupt input recording: " + path);
+			}
+			frame += static_cast<uint32_t>(frames);
+			micros += elapsed;
+			record.frame = frame;
+			record.micros = micros;
+			record.value = input_log::unzigzag(value);
+			records.push_back(std::move(record));
+		}
+		start = std::chrono::steady_clock::now();
+	}
+
+	InputReplay(const InputReplay&) = delete;
+	InputReplay& operator=(const InputReplay&) = delete;
+
+	// Next recorded event of this frame, if any. In real time it is held back until its
+	// recorded time.
+	bool poll(uint32_t frame, SDL_Event& event) {
+		if (next >= records.size() || records[next].frame > frame) {
+			return false;
+		}
+		const InputRecord& record = records[next];
+		if (record.kind == InputRecord::LevelSwitch) {
+			throw diverged(frame, "expected a switch to level " + std::to_string(record.value) + " (" + record.title + ")");
+		}
+		if (realtime) {
+			std::this_thread::sleep_until(start + std::chrono::microseconds(record.micros));
+		}
+		next++;
+		event = SDL_Event();
+		if (record.kind == InputRecord::Quit) {
+			event.type = SDL_QUIT;
+		}
+		else if (record.kind == InputRecord::Key) {
+			event.type = SDL_KEYDOWN;
+			event.key.keysym.sym = static_cast<int>(record.value);
+		}
+		else {
+			event.type = SDL_MOUSEWHEEL;
+			event.wheel.y = static_cast<Sint32>(record.value);
+		}
+		events++;
+		return true;
+	}
+
+	// Index of the level switch the recording has next, if that is its next record. The
+	// level select screen picks it in place of its own selection.
+	std::optional<std::size_t> pending_level() const {
+		if (next < records.size() && records[next].kind == InputRecord::LevelSwitch && records[next].value >= 0) {
+			return static_cast<std::size_t>(records[next].value);
+		}
+		return std::nullopt;
+	}
+
+	// Matches a level switch of the game against the recording.
+	void check_level(uint32_t frame, std::size_t index, const std::string& title) {
+		if (next >= records.size() || records[next].kind != InputRecord::LevelSwitch) {
+			throw diverged(frame, "switched to level " + std::to_string(index) + " (" + title + ") that was not recorded");
+		}
+		if (records[next].value != static_cast<int64_t>(index) || records[next].title != title) {
+			throw diverged(frame, "switched to level " + std::to_string(index) + " (" + title + ") instead of "
+				+ std::to_string(records[next].value) + " (" + records[next].title + ")");
+		}
+		next++;
+		switches++;
+	}
+
+	bool finished() const { return next >= records.size(); }
+	bool is_realtime() const { return realtime; }
+
+	// Time the frame took without the wait for the next one.
+	void frame_done(double seconds) { frame_seconds.push_back(seconds); }
+
+	void report(std::ostream& out) const {
+		double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::vector<double> sorted = frame_seconds;
+		std::sort(sorted.begin(), sorted.end());
+		double busy = 0.0;
+		for (double seconds : sorted) busy += seconds;
+		auto percentile = [&sorted](double p) { return sorted.empty() ? 0.0 : sorted[static_cast<std::size_t>(p * (sorted.size() - 1))] * 1000.0; };
+		out << "replayed " << events << " events and " << switches << " level switches in " << sorted.size() << " frames, "
+			<< total << "s (" << (realtime ? "real time" : "fast") << ")\n";
+		out << "frame time: mean " << (sorted.empty() ? 0.0 : busy * 1000.0 / sorted.size()) << " ms, median " << percentile(0.5)
+			<< " ms, p99 " << percentile(0.99) << " ms, max " << percentile(1.0) << " ms\n";
+	}
+
+private:
+	std::string path;
+	bool realtime;
+	std::vector<InputRecord> records;
+	std::size_t next = 0;
+	std::chrono::steady_clock::time_point start;
+	uint64_t events = 0;
+	uint64_t switches = 0;
+	std::vector<double> frame_seconds;
+
+	std::runtime_error diverged(uint32_t frame, const std::string& what) const {
+		return std::runtime_error("Replay of " + path + " diverged at frame " + std::to_string(frame) + ": " + what);
+	}
+};
+
+#endif
\ No newline at end of file
@@ -1,8 +1,79 @@
 #include "level.h"
-#include <sstream>
+#include "deadlock.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEVEL_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Bit i of a mask is set when byte i of a 16 byte block holds that kind of cell.
+struct RowMasks {
+	uint32_t wall;
+	uint32_t goal;
+	uint32_t box;
+	uint32_t player;
+};
+
+// Also upper-cases the block in place, as the board keeps rows upper case.
+RowMasks classify_block(char* block) {
+	RowMasks masks;
+#ifdef LEVEL_SSE2
+	__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+	auto is = [&bytes](char c) { return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)); };
+	__m128i box_on_goal = is('*');
+	__m128i player_on_goal = is('+');
+	masks.wall = static_cast<uint32_t>(_mm_movemask_epi8(is('#')));
+	masks.goal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(is('.'), box_on_goal), player_on_goal)));
+	masks.box = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(is('$'), box_on_goal)));
+	masks.player = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(is('@'), player_on_goal)));
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('z' + 1)));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(block), _mm_sub_epi8(bytes, _mm_and_si128(lower, _mm_set1_epi8(0x20))));
+#else
+	masks = RowMasks{ 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		char c = block[i];
+		uint32_t bit = 1u << i;
+		masks.wall |= c == '#' ? bit : 0;
+		masks.goal |= c == '.' || c == '*' || c == '+' ? bit : 0;
+		masks.box |= c == '$' || c == '*' ? bit : 0;
+		masks.player |= c == '@' || c == '+' ? bit : 0;
+		if (c >= 'a' && c <= 'z') block[i] = static_cast<char>(c - 'a' + 'A');
+	}
+#endif
+	return masks;
+}
+
+int lowest_bit(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+int highest_bit(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, mask);
+	return static_cast<int>(index);
+#else
+	return 31 - __builtin_clz(mask);
+#endif
+}
+
+}
+
 Level::Level(const std::string& data) {
 	parse_data(data);
 }
@@ -19,6 +90,28 @@ const Direction& Level::get_prev_dir() const {
 	return prev_dir;
 }
 
+const std::pair<int, int>& Level::get_player() const {
+	return player;
+}
+
+const std::vector<std::pair<int, int>>& Level::get_walls() const {
+	return walls;
+}
+
+const std::vector<std::pair<int, int>>& Level::get_squares() const {
+	return squares;
+}
+
+const std::vector<std::pair<int, int>>& Level::get_boxes() const {
+	return boxes;
+}
+
+// Walls and goals never change after parsing, so clones share the id of the level
+// they were copied from while every parsed level gets a new one.
+uint64_t Level::get_layout_id() const {
+	return layout_id;
+}
+
 const std::vector<std::vector<char>>& Level::get_board() const {
 	return board;
 }
@@ -31,34 +124,23 @@ const std::string& Level::get_title() const {
 	return title;
 }
 
-const bool& Level::check_squares_pos(std::pair<int, int> pos) const {
-	for (auto& row : squares) {
-		if (row == pos) {
-			return true;
-		}
-	}
-	return false;
+bool Level::on_board(std::pair<int, int> pos) const {
+	return pos.first >= 0 && pos.second >= 0 && pos.first < level_dimensions.first && pos.second < level_dimensions.second;
 }
 
-const bool& Level::check_walls_pos(std::pair<int, int> pos) const {
-	for (auto& row : walls) {
-		if (row == pos) {
-			return true;
-		}
-	}
-	return false;
+bool Level::check_squares_pos(std::pair<int, int> pos) const {
+	return on_board(pos) && (cells[cell_of(pos)] & cell_goal);
 }
 
-const bool& Level::check_boxes_pos(std::pair<int, int> pos) const {
-	for (auto& row : boxes) {
-		if (row == pos) {
-			return true;
-		}
-	}
-	return false;
+bool Level::check_walls_pos(std::pair<int, int> pos) const {
+	return on_board(pos) && (cells[cell_of(pos)] & cell_wall);
+}
+
+bool Level::check_boxes_pos(std::pair<int, int> pos) const {
+	return on_board(pos) && (cells[cell_of(pos)] & cell_box);
 }
 
-const bool& Level::check_player_pos(std::pair<int, int> pos)const {
+bool Level::check_player_pos(std::pair<int, int> pos)const {
 	if (player == pos) {
 		return true;
 	}
@@ -75,113 +157,160 @@ void Level::print() const {
 }
 
 void Level::parse_data(const std::string& data) {
-	std::istringstream stream(data);
-	std::string line;
 	board.clear();
 	int width = 0;
 	int height = 0;
-	while (std::getline(stream, line)) {
-		if (line.empty()) continue;
+	for (std::size_t start = 0; start < data.size();) {
+		std::size_t stop = data.find('\n', start);
+		if (stop == std::string::npos) stop = data.size();
+		std::size_t length = stop - start;
+		while (length > 0 && (data[start + length - 1] == '\0' || data[start + length - 1] == '\r')) {
+			length--;
+		}
+		if (length > 0) {
+			board.emplace_back(data.begin() + start, data.begin() + start + length);
+			classify_row(board.back(), height);
+			width = std::max(width, static_cast<int32_t>(length));
+			height++;
+		}
+		start = stop + 1;
+	}
+	level_dimensions = std::make_pair(width, height);
+	build_cells();
 
-		std::transform(line.begin(), line.end(), line.begin(), ::toupper);
+	static std::atomic<uint64_t> next_layout_id(1);
+	layout_id = next_layout_id++;
+}
 
-		std::vector<char> row(line.begin(), line.end());
-		board.push_back(row);
+void Level::build_cells() {
+	int row = level_dimensions.first + 2;
+	if (row <= 16) {
+		width_class = 16;
+		step_kernel = &Level::step_cells<16>;
+	}
+	else if (row <= 32) {
+		width_class = 32;
+		step_kernel = &Level::step_cells<32>;
+	}
+	else if (row <= 64) {
+		width_class = 64;
+		step_kernel = &Level::step_cells<64>;
+	}
+	else {
+		width_class = 0;
+		step_kernel = &Level::step_cells<0>;
+	}
+	stride = width_class ? width_class : row;
 
-		width = std::max(width, static_cast<int32_t>(line.size()));
-		height++;
+	cells.assign(static_cast<std::size_t>(stride) * (level_dimensions.second + 2), cell_outside);
+	for (int y = 0; y < level_dimensions.second; y++) {
+		std::fill_n(cells.begin() + cell_of(std::make_pair(0, y)), level_dimensions.first, 0);
 	}
+	for (const auto& wall : walls) cells[cell_of(wall)] |= cell_wall;
+	for (const auto& square : squares) cells[cell_of(square)] |= cell_goal;
+	for (const auto& box : boxes) cells[cell_of(box)] |= cell_box;
+}
 
-	width--;
-	int countHeight = 0;
-	for (const auto& row : board) {
-		int countWidth = 0;
-		for (char cell : row) {
-			auto tempPair = std::make_pair(countWidth, countHeight);
-			if (cell == '#') {
-				walls.push_back(tempPair);
-			}
-			else if (cell == '.') {
-				squares.push_back(tempPair);
-			}
-			else if (cell == '$') {
-				boxes.push_back(tempPair);
-			}
-			else if (cell == '@') {
-				player = tempPair;
-			}
-			else if (cell == '+') {
-				player = tempPair;
-				squares.push_back(tempPair);
-			}
-			else if (cell == '*') {
-				boxes.push_back(tempPair);
-				squares.push_back(tempPair);
-			}
-			countWidth++;
+int Level::get_width_class() const {
+	return width_class;
+}
+
+// Sorts the cells of a row into walls, goals, boxes and the player 16 at a time,
+// keeping each list in row order.
+void Level::classify_row(std::vector<char>& row, int y) {
+	for (std::size_t x = 0; x < row.size(); x += 16) {
+		char block[16] = {};
+		std::size_t count = std::min<std::size_t>(16, row.size() - x);
+		std::memcpy(block, row.data() + x, count);
+		RowMasks masks = classify_block(block);
+		std::memcpy(row.data() + x, block, count);
+
+		int column = static_cast<int>(x);
+		for (uint32_t mask = masks.wall; mask; mask &= mask - 1) {
+			walls.push_back(std::make_pair(column + lowest_bit(mask), y));
+		}
+		for (uint32_t mask = masks.goal; mask; mask &= mask - 1) {
+			squares.push_back(std::make_pair(column + lowest_bit(mask), y));
+		}
+		for (uint32_t mask = masks.box; mask; mask &= mask - 1) {
+			boxes.push_back(std::make_pair(column + lowest_bit(mask), y));
+		}
+		if (masks.player) {
+			player = std::make_pair(column + highest_bit(masks.player), y);
 		}
-		countHeight++;
 	}
-	level_dimensions = std::make_pair(width, height);
 }
 
 Level Level::clone() const {
 	return *this;
 }
 
+void Level::set_deadlock_database(const DeadlockDatabase* database) {
+	deadlock_database = database;
+}
+
+bool Level::is_deadlocked() const {
+	return deadlocked;
+}
+
 bool Level::is_completed() const {
 	return boxes.size() == squares.size() &&
 		std::is_permutation(boxes.begin(), boxes.end(), squares.begin());
 }
-const std::pair<int, int>& Level::get_next_position(Direction dir) const {
-	if (dir == Direction::Left) {
-		return std::make_pair(player.first - 1, player.second);
-	}
-	else if (dir == Direction::Right) {
-		return std::make_pair(player.first + 1, player.second);
-	}
-	else if (dir == Direction::Up) {
-		return std::make_pair(player.first, player.second - 1);
-	}
-	else if (dir == Direction::Down) {
-		return std::make_pair(player.first, player.second + 1);
-	}
+std::pair<int, int> Level::get_next_position(Direction dir) const {
+	return box_next_position(dir, player);
 }
 
-const std::pair<int, int>& Level::box_next_position(Direction dir, std::pair<int, int> next_pos) const {
-	if (dir == Direction::Left) {
-		return std::make_pair(next_pos.first - 1, next_pos.second);
-	}
-	else if (dir == Direction::Right) {
-		return std::make_pair(next_pos.first + 1, next_pos.second);
-	}
-	else if (dir == Direction::Up) {
-		return std::make_pair(next_pos.first, next_pos.second - 1);
-	}
-	else if (dir == Direction::Down) {
-		return std::make_pair(next_pos.first, next_pos.second + 1);
-	}
+std::pair<int, int> Level::box_next_position(Direction dir, std::pair<int, int> next_pos) const {
+	int d = static_cast<int>(dir);
+	return std::make_pair(next_pos.first + direction_dx[d], next_pos.second + direction_dy[d]);
 }
 
-void Level::step(Direction dir) {
-	prev_dir = dir;
-	auto next_player_pos = get_next_position(dir);
+namespace {
+
+template <int Stride>
+constexpr int cell_offsets[4] = { -1, 1, -Stride, Stride };
+
+}
 
-	if (!check_walls_pos(next_player_pos) && !check_boxes_pos(next_player_pos)) {
+// Stride is the row length when it is known at compile time, which turns every
+// neighbour into a constant offset; 0 reads it from the level.
+template <int Stride>
+void Level::step_cells(Direction dir) {
+	int d = static_cast<int>(dir);
+	int offset = Stride ? cell_offsets<Stride>[d] : direction_dx[d] + direction_dy[d] * stride;
+	int next = (player.second + 1) * (Stride ? Stride : stride) + player.first + 1 + offset;
+	uint8_t target = cells[next];
+	if (target & (cell_wall | cell_outside)) {
+		return;
+	}
+	std::pair<int, int> next_player_pos = std::make_pair(player.first + direction_dx[d], player.second + direction_dy[d]);
+	if (target & cell_box) {
+		if (cells[next + offset] & (cell_wall | cell_outside | cell_box)) {
+			return;
+		}
+		cells[next] &= ~cell_box;
+		cells[next + offset] |= cell_box;
+		auto next_box_pos = std::make_pair(next_player_pos.first + direction_dx[d], next_player_pos.second + direction_dy[d]);
+		auto it = std::find(boxes.begin(), boxes.end(), next_player_pos);
+		if (it != boxes.end()) {
+			*it = next_box_pos;
+		}
 		player = next_player_pos;
 		steps++;
-	}
-	else if (check_boxes_pos(next_player_pos)) {
-		auto next_box_pos = box_next_position(dir, next_player_pos);
-		if (!check_walls_pos(next_box_pos) && !check_boxes_pos(next_box_pos)) {
-			player = next_player_pos;
-			steps++;
-			boxes.push_back(next_box_pos);
-			auto it = std::find(boxes.begin(), boxes.end(), next_player_pos);
-			if (it != boxes.end()) {
-				boxes.erase(it);
-			}
+		if (deadlock_database && !deadlocked) {
+			deadlocked = deadlock_database->is_deadlocked(*this, next_box_pos);
 		}
+		return;
+	}
+	player = next_player_pos;
+	steps++;
+}
+
+void Level::step(Direction dir) {
+	prev_dir = dir;
+	// A level without a player has nothing to move.
+	if (on_board(player)) {
+		(this->*step_kernel)(dir);
 	}
-	return;
 }
\ No newline at end of file
@@ -1,12 +1,19 @@
 #ifndef LEVEL_H_
 #define LEVEL_H_
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
 
 enum class Direction { Left, Right, Up, Down };
 
+// Column and row step of each Direction, indexed by its value.
+constexpr int direction_dx[4] = { -1, 1, 0, 0 };
+constexpr int direction_dy[4] = { 0, 0, -1, 1 };
+
+class DeadlockDatabase;
+
 class Level {
 public:
 
@@ -18,35 +25,64 @@ public:
 
 	const std::vector<std::vector<char>>& get_board() const;
 	const int& get_steps() const;
-	const bool& check_squares_pos(std::pair<int, int> pos) const;
-	const bool& check_walls_pos(std::pair<int, int> pos) const;
-	const bool& check_boxes_pos(std::pair<int, int> pos) const;
-	const bool& check_player_pos(std::pair<int, int> pos) const;
+	bool check_squares_pos(std::pair<int, int> pos) const;
+	bool check_walls_pos(std::pair<int, int> pos) const;
+	bool check_boxes_pos(std::pair<int, int> pos) const;
+	bool check_player_pos(std::pair<int, int> pos) const;
+	bool on_board(std::pair<int, int> pos) const;
 	const std::string& get_title() const;
 	const std::pair<int, int>& get_level_dimensions() const;
-	const std::pair<int, int>& get_next_position(Direction dir) const;
-	const std::pair<int, int>& box_next_position(Direction dir, std::pair<int, int> next_pos) const;
+	std::pair<int, int> get_next_position(Direction dir) const;
+	std::pair<int, int> box_next_position(Direction dir, std::pair<int, int> next_pos) const;
 	const Direction& get_prev_dir() const;
+	const std::pair<int, int>& get_player() const;
+	const std::vector<std::pair<int, int>>& get_walls() const;
+	const std::vector<std::pair<int, int>>& get_squares() const;
+	const std::vector<std::pair<int, int>>& get_boxes() const;
+	uint64_t get_layout_id() const;
+	// Row length the movement code was compiled for (16, 32 or 64 cells including the
+	// outside ring), or 0 when the board is wider and the row length is read at run time.
+	int get_width_class() const;
 	Level clone() const;
 
+	void set_deadlock_database(const DeadlockDatabase* database);
+
 	void step(Direction dir);
 
 	bool is_completed() const;
+	bool is_deadlocked() const;
 private:
-	Direction prev_dir;
+	Direction prev_dir = Direction::Down;
 	std::vector<std::vector<char>> board;
-	int steps;
+	int steps = 0;
 	std::string title;
 
 	std::pair<int, int> level_dimensions;
+	uint64_t layout_id = 0;
 
 	std::vector<std::pair<int, int>> walls;
-	std::pair<int, int> player;
+	std::pair<int, int> player = { -1, -1 };
 	std::vector<std::pair<int, int>> squares;
 	std::vector<std::pair<int, int>> boxes;
 
+	const DeadlockDatabase* deadlock_database = nullptr;
+	bool deadlocked = false;
+
+	// Walls, goals and boxes by linear cell index, with a ring of outside cells around
+	// the board so a move never leaves the grid. A row is stride cells.
+	enum : uint8_t { cell_wall = 1, cell_goal = 2, cell_box = 4, cell_outside = 8 };
+	std::vector<uint8_t> cells;
+	int stride = 0;
+	int width_class = 0;
+	// step_cells instantiated for the board's width class, chosen when parsing.
+	void (Level::*step_kernel)(Direction) = nullptr;
 
 	void parse_data(const std::string& data);
+	void classify_row(std::vector<char>& row, int y);
+	void build_cells();
+	int cell_of(std::pair<int, int> pos) const { return (pos.second + 1) * stride + pos.first + 1; }
+	template <int Stride>
+	void step_cells(Direction dir);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "level_analysis.h"
+#include <algorithm>
+
+namespace {
+
+void direction_offsets(int width, int offsets[4]) {
+	offsets[0] = -1;
+	offsets[1] = 1;
+	offsets[2] = -width;
+	offsets[3] = width;
+}
+
+bool is_doorway(const std::vector<uint8_t>& walls, int width, int cell, int d) {
+	return d < 2 ? (walls[cell - width] && walls[cell + width]) : (walls[cell - 1] && walls[cell + 1]);
+}
+
+// Iterative Tarjan: a non-root cell is an articulation square when some child's subtree
+// has no back edge above it, the root when it has more than one child.
+void find_articulations(LayoutAnalysis& layout, const std::vector<uint8_t>& floor, int width, int root) {
+	int offsets[4];
+	direction_offsets(width, offsets);
+	std::vector<int> order(floor.size(), -1);
+	std::vector<int> low(floor.size(), 0);
+	std::vector<int> parent(floor.size(), -1);
+	std::vector<std::pair<int, int>> stack;
+	int time = 0;
+	int root_children = 0;
+
+	order[root] = low[root] = time++;
+	stack.push_back(std::make_pair(root, 0));
+	while (!stack.empty()) {
+		int cell = stack.back().first;
+		int d = stack.back().second;
+		if (d < 4) {
+			stack.back().second++;
+			int next = cell + offsets[d];
+			if (!floor[next]) continue;
+			if (order[next] < 0) {
+				parent[next] = cell;
+				order[next] = low[next] = time++;
+				if (cell == root) root_children++;
+				stack.push_back(std::make_pair(next, 0));
+			}
+			else if (next != parent[cell]) {
+				low[cell] = std::min(low[cell], order[next]);
+			}
+			continue;
+		}
+		stack.pop_back();
+		if (!stack.empty()) {
+			int up = stack.back().first;
+			low[up] = std::min(low[up], low[cell]);
+			if (up != root && low[cell] >= order[up]) {
+				layout.articulation[up] = 1;
+			}
+		}
+	}
+	if (root_children > 1) {
+		layout.articulation[root] = 1;
+	}
+}
+
+// Works out the last goal first: a goal can be filled last when a box pushed in through
+// the doorway reaches it with every other remaining goal already occupied.
+bool plan_room(GoalRoom& room, const std::vector<uint8_t>& walls, const std::vector<int>& room_goals, int width) {
+	int offsets[4];
+	direction_offsets(width, offsets);
+	int approach = room.entrance - offsets[room.inward];
+
+	std::vector<uint8_t> blocked(walls.size(), 1);
+	for (std::size_t i = 0; i < walls.size(); i++) {
+		if (room.inside[i]) blocked[i] = walls[i];
+	}
+	blocked[room.entrance] = 0;
+	blocked[approach] = 0;
+
+	std::vector<int> depth(walls.size(), -1);
+	std::vector<int> queue = { room.entrance };
+	depth[room.entrance] = 0;
+	for (std::size_t i = 0; i < queue.size(); i++) {
+		for (int d = 0; d < 4; d++) {
+			int next = queue[i] + offsets[d];
+			if (blocked[next] || depth[next] >= 0 || next == approach) continue;
+			depth[next] = depth[queue[i]] + 1;
+			queue.push_back(next);
+		}
+	}
+
+	std::vector<int> remaining = room_goals;
+	std::sort(remaining.begin(), remaining.end(), [&depth](int a, int b) { return depth[a] < depth[b]; });
+	for (int goal : remaining) blocked[goal] = 1;
+
+	std::vector<int> directions;
+	while (!remaining.empty()) {
+		bool placed = false;
+		for (std::size_t i = 0; i < remaining.size() && !placed; i++) {
+			int goal = remaining[i];
+			blocked[goal] = 0;
+			if (find_box_path(blocked, width, room.entrance, approach, goal, directions)) {
+				room.fill_order.push_back(goal);
+				room.paths.push_back(directions);
+				remaining.erase(remaining.begin() + i);
+				placed = true;
+			}
+			else {
+				blocked[goal] = 1;
+			}
+		}
+		if (!placed) {
+			return false;
+		}
+	}
+	std::reverse(room.fill_order.begin(), room.fill_order.end());
+	std::reverse(room.paths.begin(), room.paths.end());
+	return true;
+}
+
+// The smallest region behind an articulation doorway that holds every goal, no box and
+// not the player, and whose goals can be filled in some order.
+void find_goal_room(LayoutAnalysis& layout, const std::vector<uint8_t>& floor, const std::vector<uint8_t>& walls,
+	const std::vector<uint8_t>& goals, int width, int player, const std::vector<uint16_t>& boxes) {
+	int offsets[4];
+	direction_offsets(width, offsets);
+	std::vector<uint8_t> box_cells(walls.size(), 0);
+	for (uint16_t box : boxes) box_cells[box] = 1;
+	int goal_count = static_cast<int>(std::count(goals.begin(), goals.end(), 1));
+
+	std::vector<GoalRoom> candidates;
+	for (int cell = 0; cell < static_cast<int>(walls.size()); cell++) {
+		if (!layout.articulation[cell] || goals[cell] || box_cells[cell]) continue;
+		for (int d = 0; d < 4; d++) {
+			int start = cell + offsets[d];
+			if (!floor[start] || !floor[cell - offsets[d]] || !is_doorway(walls, width, cell, d)) continue;
+
+			GoalRoom room;
+			room.entrance = cell;
+			room.inward = d;
+			room.inside.assign(walls.size(), 0);
+			room.inside[start] = 1;
+			std::vector<int> area = { start };
+			bool usable = true;
+			int goals_inside = 0;
+			for (std::size_t i = 0; i < area.size(); i++) {
+				int at = area[i];
+				usable = usable && !box_cells[at] && at != player;
+				goals_inside += goals[at];
+				for (int e = 0; e < 4; e++) {
+					int next = at + offsets[e];
+					if (!floor[next] || next == cell || room.inside[next]) continue;
+					room.inside[next] = 1;
+					area.push_back(next);
+				}
+			}
+			if (usable && goals_inside == goal_count) {
+				candidates.push_back(std::move(room));
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const GoalRoom& a, const GoalRoom& b) {
+		return std::count(a.inside.begin(), a.inside.end(), 1) < std::count(b.inside.begin(), b.inside.end(), 1);
+	});
+	for (GoalRoom& room : candidates) {
+		std::vector<int> room_goals;
+		for (int cell = 0; cell < static_cast<int>(walls.size()); cell++) {
+			if (room.inside[cell] && goals[cell]) room_goals.push_back(cell);
+		}
+		if (plan_room(room, walls, room_goals, width)) {
+			layout.room = std::move(room);
+			layout.has_room = true;
+			return;
+		}
+	}
+}
+
+}
+
+bool find_box_path(const std::vector<uint8_t>& blocked, int width, int box, int player, int target, std::vector<int>& directions) {
+	directions.clear();
+	if (box == target) {
+		return true;
+	}
+	int offsets[4];
+	direction_offsets(width, offsets);
+
+	// State cell * 4 + d: the box was just pushed onto cell in direction d, the player behind it.
+	std::vector<int> came_from(blocked.size() * 4, -2);
+	std::vector<uint32_t> seen(blocked.size(), 0);
+	uint32_t stamp = 0;
+	std::vector<int> area;
+	std::vector<int> open;
+	auto expand = [&](int box_cell, int player_cell, int state) {
+		stamp++;
+		area.clear();
+		area.push_back(player_cell);
+		seen[player_cell] = stamp;
+		for (std::size_t i = 0; i < area.size(); i++) {
+			for (int d = 0; d < 4; d++) {
+				int next = area[i] + offsets[d];
+				if (blocked[next] || next == box_cell || seen[next] == stamp) continue;
+				seen[next] = stamp;
+				area.push_back(next);
+			}
+		}
+		for (int d = 0; d < 4; d++) {
+			int stand = box_cell - offsets[d];
+			int next = box_cell + offsets[d];
+			int child = next * 4 + d;
+			if (seen[stand] != stamp || blocked[next] || came_from[child] != -2) continue;
+			came_from[child] = state;
+			open.push_back(child);
+			if (next == target) return child;
+		}
+		return -1;
+	};
+
+	int found = expand(box, player, -1);
+	for (std::size_t i = 0; found < 0 && i < open.size(); i++) {
+		int cell = open[i] / 4;
+		found = expand(cell, cell - offsets[open[i] % 4], open[i]);
+	}
+	if (found < 0) {
+		return false;
+	}
+	for (int state = found; state >= 0; state = came_from[state]) {
+		directions.push_back(state % 4);
+	}
+	std::reverse(directions.begin(), directions.end());
+	return true;
+}
+
+LayoutAnalysis analyze_layout(const std::vector<uint8_t>& walls, const std::vector<uint8_t>& goals, int width,
+	int player, const std::vector<uint16_t>& boxes) {
+	int offsets[4];
+	direction_offsets(width, offsets);
+	LayoutAnalysis layout;
+	layout.tunnel.assign(walls.size(), 0);
+	layout.articulation.assign(walls.size(), 0);
+
+	std::vector<uint8_t> floor(walls.size(), 0);
+	std::vector<int> area = { player };
+	floor[player] = 1;
+	for (std::size_t i = 0; i < area.size(); i++) {
+		for (int d = 0; d < 4; d++) {
+			int next = area[i] + offsets[d];
+			if (walls[next] || floor[next]) continue;
+			floor[next] = 1;
+			area.push_back(next);
+		}
+	}
+
+	for (int cell : area) {
+		if (walls[cell - width] && walls[cell + width]) layout.tunnel[cell] |= LayoutAnalysis::HorizontalTunnel;
+		if (walls[cell - 1] && walls[cell + 1]) layout.tunnel[cell] |= LayoutAnalysis::VerticalTunnel;
+		layout.tunnel_cells += layout.tunnel[cell] ? 1 : 0;
+	}
+
+	find_articulations(layout, floor, width, player);
+	layout.articulation_cells = static_cast<int>(std::count(layout.articulation.begin(), layout.articulation.end(), 1));
+	find_goal_room(layout, floor, walls, goals, width, player, boxes);
+	return layout;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef LEVEL_ANALYSIS_H_
+#define LEVEL_ANALYSIS_H_
+
+#include <cstdint>
+#include <vector>
+
+// A region that holds every goal and is entered through a single doorway. Boxes are parked
+// in fill_order; paths[k] are the push directions that take a box from the doorway to
+// fill_order[k] once the goals before it are filled.
+struct GoalRoom {
+	int entrance = -1;
+	int inward = -1;
+	std::vector<uint8_t> inside;
+	std::vector<int> fill_order;
+	std::vector<std::vector<int>> paths;
+};
+
+// Static structure of a level's floor, on the solver's padded grid.
+struct LayoutAnalysis {
+	enum : uint8_t { HorizontalTunnel = 1, VerticalTunnel = 2 };
+
+	// Per cell: HorizontalTunnel when the cells above and below are walls, VerticalTunnel
+	// when the cells left and right are.
+	std::vector<uint8_t> tunnel;
+	// Per cell: 1 when removing the cell disconnects the player's floor.
+	std::vector<uint8_t> articulation;
+	bool has_room = false;
+	GoalRoom room;
+	int tunnel_cells = 0;
+	int articulation_cells = 0;
+};
+
+LayoutAnalysis analyze_layout(const std::vector<uint8_t>& walls, const std::vector<uint8_t>& goals, int width,
+	int player, const std::vector<uint16_t>& boxes);
+
+// Shortest push path of one box from `box` to `target` with the player starting on `player`.
+// Cells with `blocked` set are walls or other boxes. Fills the push directions and returns
+// false when the box cannot get there.
+bool find_box_path(const std::vector<uint8_t>& blocked, int width, int box, int player, int target, std::vector<int>& directions);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,411 @@
+#ifndef LEVEL_SELECT_H_
+#define LEVEL_SELECT_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+#include "level.h"
+#include "level_source.h"
+#include "renderer.h"
+
+// Grid of level thumbnails for jumping to any level of the pack. A loader thread
+// streams the pack and worker threads rasterize thumbnails into CPU surfaces, visible
+// ones first; the frame loop only uploads a bounded number of finished surfaces into
+// atlas pages per frame and draws the rows that are on screen, so the grid shows up at
+// once and fills in while the pack is still loading. With wait_for_load, navigation
+// waits until the whole pack is loaded, so it does not depend on how far the loader has
+// got; replays use this.
+class LevelSelect {
+public:
+	static const int thumbnail_size = 64;
+	static const int page_size = 2048;
+	static const int per_page = (page_size / thumbnail_size) * (page_size / thumbnail_size);
+	static const int uploads_per_frame = 32;
+
+	LevelSelect(const std::string& path, int screen_width, int screen_height, bool wait_for_load = false)
+		: path(path), screen_width(screen_width), screen_height(screen_height), wait_for_load(wait_for_load) {}
+
+	~LevelSelect() {
+		stop.store(true);
+		work_ready.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		for (auto& item : finished) {
+			SDL_FreeSurface(item.surface);
+		}
+		for (SDL_Texture* page : pages) {
+			SDL_DestroyTexture(page);
+		}
+	}
+
+	LevelSelect(const LevelSelect&) = delete;
+	LevelSelect& operator=(const LevelSelect&) = delete;
+
+	// Starts loading on first use, so packs that are only played linearly cost nothing.
+	void open(std::size_t current) {
+		if (threads.empty()) {
+			threads.emplace_back(&LevelSelect::load, this);
+			unsigned workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+			for (unsigned i = 0; i < workers; i++) {
+				threads.emplace_back(&LevelSelect::rasterize, this);
+			}
+		}
+		selected = current;
+		scroll_to(selected);
+	}
+
+	// Blocks only when the player has moved past the levels loaded so far.
+	std::optional<Level> get_level(std::size_t index) {
+		std::unique_lock<std::mutex> lock(mutex);
+		level_loaded.wait(lock, [&] { return index < levels.size() || loaded || stop.load(); });
+		if (index < levels.size()) {
+			return levels[index];
+		}
+		return std::nullopt;
+	}
+
+	// Returns the picked level index, if any; closed is set when the screen should go away.
+	std::optional<std::size_t> handle_event(const SDL_Event& event, bool& closed) {
+		std::size_t count = wait_for_load ? loaded_count() : level_count();
+		int columns = get_columns();
+		if (event.type == SDL_QUIT) {
+			closed = true;
+		}
+		else if (event.type == SDL_MOUSEWHEEL) {
+			scroll -= event.wheel.y * (thumbnail_size + gap);
+			clamp_scroll(count);
+		}
+		else if (event.type == SDL_KEYDOWN && count > 0) {
+			switch (event.key.keysym.sym) {
+			case SDLK_ESCAPE:
+			case SDLK_l:
+				closed = true;
+				break;
+			case SDLK_RETURN:
+				closed = true;
+				return selected;
+			case SDLK_LEFT:
+				selected = selected > 0 ? selected - 1 : 0;
+				break;
+			case SDLK_RIGHT:
+				selected = std::min(selected + 1, count - 1);
+				break;
+			case SDLK_UP:
+				selected = selected >= static_cast<std::size_t>(columns) ? selected - columns : selected;
+				break;
+			case SDLK_DOWN:
+				selected = std::min(selected + columns, count - 1);
+				break;
+			case SDLK_PAGEUP:
+				selected -= std::min(selected, static_cast<std::size_t>(columns * visible_rows()));
+				break;
+			case SDLK_PAGEDOWN:
+				selected = std::min(selected + columns * visible_rows(), count - 1);
+				break;
+			case SDLK_HOME:
+				selected = 0;
+				break;
+			case SDLK_END:
+				selected = count - 1;
+				break;
+			default:
+				break;
+			}
+			scroll_to(selected);
+		}
+		return std::nullopt;
+	}
+
+	void render(SDL_Renderer* renderer, Renderer& text) {
+		upload(renderer);
+
+		std::size_t count = level_count();
+		int columns = get_columns();
+		int row_height = thumbnail_size + gap;
+		int first_row = scroll / row_height;
+		int last_row = (scroll + grid_height()) / row_height;
+		focus.store(static_cast<std::size_t>(first_row) * columns);
+
+		SDL_Rect clip = { 0, 0, screen_width, grid_height() };
+		SDL_RenderSetClipRect(renderer, &clip);
+		for (int row = first_row; row <= last_row; row++) {
+			for (int column = 0; column < columns; column++) {
+				std::size_t index = static_cast<std::size_t>(row) * columns + column;
+				if (index >= count) break;
+				SDL_Rect dst = { gap + column * (thumbnail_size + gap), gap + row * row_height - scroll, thumbnail_size, thumbnail_size };
+				if (index < uploaded.size() && uploaded[index]) {
+					SDL_Rect src = slot_rect(index);
+					SDL_RenderCopy(renderer, pages[index / per_page], &src, &dst);
+				}
+				else {
+					SDL_SetRenderDrawColor(renderer, 210, 210, 210, 255);
+					SDL_RenderFillRect(renderer, &dst);
+				}
+				if (index == selected) {
+					SDL_Rect outline = { dst.x - 2, dst.y - 2, dst.w + 4, dst.h + 4 };
+					SDL_SetRenderDrawColor(renderer, 0, 120, 215, 255);
+					SDL_RenderDrawRect(renderer, &outline);
+				}
+			}
+		}
+		SDL_RenderSetClipRect(renderer, nullptr);
+
+		std::string status = "select level: ";
+		if (count > 0) {
+			status += std::to_string(selected + 1) + "/" + std::to_string(count) + "  " + title(selected);
+		}
+		status += "     thumbnails " + std::to_string(uploaded_count) + "/" + std::to_string(count);
+		if (!loaded_flag.load()) {
+			status += ", loading";
+		}
+		std::string load_error = get_error();
+		if (!load_error.empty()) {
+			status += ", " + load_error;
+		}
+		SDL_Color black = { 0, 0, 0, 255 };
+		text.draw_text(status, 0, screen_height - 32, black, screen_width, 32);
+	}
+
+private:
+	struct Finished {
+		std::size_t index;
+		SDL_Surface* surface;
+	};
+
+	static const int gap = 8;
+
+	std::string path;
+	int screen_width;
+	int screen_height;
+	bool wait_for_load;
+
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable level_loaded;
+	std::vector<Level> levels;
+	std::vector<uint8_t> claimed;
+	std::deque<Finished> finished;
+	bool loaded = false;
+	std::string error;
+	std::atomic<bool> loaded_flag{ false };
+	std::atomic<bool> stop{ false };
+	std::atomic<std::size_t> focus{ 0 };
+	std::vector<std::thread> threads;
+
+	std::vector<SDL_Texture*> pages;
+	std::vector<uint8_t> uploaded;
+	std::size_t uploaded_count = 0;
+	std::size_t selected = 0;
+	int scroll = 0;
+
+	std::size_t level_count() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return levels.size();
+	}
+
+	std::size_t loaded_count() {
+		std::unique_lock<std::mutex> lock(mutex);
+		level_loaded.wait(lock, [&] { return loaded || stop.load(); });
+		return levels.size();
+	}
+
+	std::string title(std::size_t index) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return index < levels.size() ? levels[index].get_title() : "";
+	}
+
+	std::string get_error() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return error;
+	}
+
+	int get_columns() const { return std::max(1, (screen_width - gap) / (thumbnail_size + gap)); }
+	int grid_height() const { return screen_height - 32; }
+	int visible_rows() const { return std::max(1, grid_height() / (thumbnail_size + gap)); }
+
+	SDL_Rect slot_rect(std::size_t index) const {
+		int slot = static_cast<int>(index % per_page);
+		int per_row = page_size / thumbnail_size;
+		return { (slot % per_row) * thumbnail_size, (slot / per_row) * thumbnail_size, thumbnail_size, thumbnail_size };
+	}
+
+	void clamp_scroll(std::size_t count) {
+		int columns = get_columns();
+		int rows = static_cast<int>((count + columns - 1) / columns);
+		int max_scroll = std::max(0, gap + rows * (thumbnail_size + gap) - grid_height());
+		scroll = std::max(0, std::min(scroll, max_scroll));
+	}
+
+	void scroll_to(std::size_t index) {
+		int row_height = thumbnail_size + gap;
+		int top = static_cast<int>(index / get_columns()) * row_height;
+		if (top < scroll) {
+			scroll = top;
+		}
+		else if (top + row_height + gap > scroll + grid_height()) {
+			scroll = top + row_height + gap - grid_height();
+		}
+		clamp_scroll(level_count());
+	}
+
+	void upload(SDL_Renderer* renderer) {
+		for (int i = 0; i < uploads_per_frame; i++) {
+			Finished item;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (finished.empty()) break;
+				item = finished.front();
+				finished.pop_front();
+			}
+			std::size_t page = item.index / per_page;
+			while (pages.size() <= page) {
+				SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, page_size, page_size);
+				if (texture) {
+					SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+				}
+				pages.push_back(texture);
+			}
+			if (pages[page]) {
+				SDL_Rect slot = slot_rect(item.index);
+				SDL_UpdateTexture(pages[page], &slot, item.surface->pixels, item.surface->pitch);
+				if (uploaded.size() <= item.index) {
+					uploaded.resize(item.index + 1, 0);
+				}
+				uploaded[item.index] = 1;
+				uploaded_count++;
+			}
+			SDL_FreeSurface(item.surface);
+		}
+	}
+
+	void load() {
+		try {
+			std::unique_ptr<LevelSource> source = open_level_source(path);
+			while (!stop.load()) {
+				std::optional<Level> level = source->next();
+				if (!level) break;
+				std::lock_guard<std::mutex> lock(mutex);
+				levels.push_back(std::move(*level));
+				claimed.push_back(0);
+				work_ready.notify_one();
+				level_loaded.notify_all();
+			}
+		}
+		catch (const std::exception& e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			error = e.what();
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded = true;
+		loaded_flag.store(true);
+		work_ready.notify_all();
+		level_loaded.notify_all();
+	}
+
+	// Takes the first unclaimed level at or after the top of the visible grid, wrapping
+	// around to the ones above it.
+	std::optional<std::size_t> claim() {
+		std::size_t start = std::min(focus.load(), claimed.size());
+		for (std::size_t i = start; i < claimed.size(); i++) {
+			if (!claimed[i]) {
+				claimed[i] = 1;
+				return i;
+			}
+		}
+		for (std::size_t i = 0; i < start; i++) {
+			if (!claimed[i]) {
+				claimed[i] = 1;
+				return i;
+			}
+		}
+		return std::nullopt;
+	}
+
+	void rasterize() {
+		for (;;) {
+			std::size_t index;
+			std::optional<Level> level;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				std::optional<std::size_t> next;
+				work_ready.wait(lock, [&] { return stop.load() || (next = claim()) || loaded; });
+				if (stop.load() || !next) return;
+				index = *next;
+				level = levels[index];
+			}
+			SDL_Surface* surface = draw_thumbnail(*level);
+			if (!surface) continue;
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back({ index, surface });
+		}
+	}
+
+	static SDL_Surface* draw_thumbnail(const Level& level) {
+		SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, thumbnail_size, thumbnail_size, 32, SDL_PIXELFORMAT_RGBA32);
+		if (!surface) return nullptr;
+
+		int width = std::max(1, level.get_level_dimensions().first);
+		int height = std::max(1, level.get_level_dimensions().second);
+		std::vector<uint8_t> cells(static_cast<std::size_t>(width) * height, 0);
+		enum { Outside, Floor, Wall, Goal, Box, BoxOnGoal, Player };
+		for (const auto& wall : level.get_walls()) cells[wall.second * width + wall.first] = Wall;
+
+		// Floor is whatever the player can walk to, so the outside stays transparent.
+		std::pair<int, int> player = level.get_player();
+		if (player.first < 0 || player.second < 0 || player.first >= width || player.second >= height) {
+			return surface;
+		}
+		std::vector<int> open = { player.second * width + player.first };
+		cells[open.front()] = Floor;
+		for (std::size_t i = 0; i < open.size(); i++) {
+			int x = open[i] % width;
+			int y = open[i] / width;
+			const int dx[] = { -1, 1, 0, 0 };
+			const int dy[] = { 0, 0, -1, 1 };
+			for (int d = 0; d < 4; d++) {
+				int nx = x + dx[d];
+				int ny = y + dy[d];
+				if (nx < 0 || ny < 0 || nx >= width || ny >= height || cells[ny * width + nx] != Outside) continue;
+				cells[ny * width + nx] = Floor;
+				open.push_back(ny * width + nx);
+			}
+		}
+		for (const auto& goal : level.get_squares()) cells[goal.second * width + goal.first] = Goal;
+		for (const auto& box : level.get_boxes()) {
+			uint8_t& cell = cells[box.second * width + box.first];
+			cell = cell == Goal ? BoxOnGoal : Box;
+		}
+		cells[player.second * width + player.first] = Player;
+
+		static const uint8_t colors[][4] = {
+			{ 0, 0, 0, 0 }, { 225, 215, 190, 255 }, { 90, 90, 100, 255 }, { 220, 60, 60, 255 },
+			{ 180, 120, 50, 255 }, { 60, 170, 60, 255 }, { 40, 90, 220, 255 },
+		};
+		int extent = std::max(width, height);
+		int left = (thumbnail_size - width * thumbnail_size / extent) / 2;
+		int top = (thumbnail_size - height * thumbnail_size / extent) / 2;
+		uint8_t* pixels = static_cast<uint8_t*>(surface->pixels);
+		for (int py = 0; py < thumbnail_size; py++) {
+			uint8_t* row = pixels + py * surface->pitch;
+			for (int px = 0; px < thumbnail_size; px++) {
+				int cx = (px - left) * extent / thumbnail_size;
+				int cy = (py - top) * extent / thumbnail_size;
+				bool inside = px >= left && py >= top && cx < width && cy < height;
+				const uint8_t* color = colors[inside ? cells[cy * width + cx] : Outside];
+				std::copy(color, color + 4, row + px * 4);
+			}
+		}
+		return surface;
+	}
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include "level_source.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+std::string decode_entities(const std::string& text) {
+	static const struct {
+		const char* name;
+		char value;
+	} entities[] = { { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' } };
+
+	std::string decoded;
+	decoded.reserve(text.size());
+	for (std::size_t i = 0; i < text.size(); i++) {
+		bool replaced = false;
+		if (text[i] == '&') {
+			for (const auto& entity : entities) {
+				if (text.compare(i, std::strlen(entity.name), entity.name) == 0) {
+					decoded += entity.value;
+					i += std::strlen(entity.name) - 1;
+					replaced = true;
+					break;
+				}
+			}
+		}
+		if (!replaced) decoded += text[i];
+	}
+	return decoded;
+}
+
+std::string attribute(const std::string& tag, const std::string& name) {
+	for (std::size_t pos = tag.find(name); pos != std::string::npos; pos = tag.find(name, pos + 1)) {
+		if (pos == 0 || !std::isspace(static_cast<unsigned char>(tag[pos - 1]))) continue;
+		std::size_t eq = tag.find_first_not_of(" \t\r\n", pos + name.size());
+		if (eq == std::string::npos || tag[eq] != '=') continue;
+		std::size_t quote = tag.find_first_not_of(" \t\r\n", eq + 1);
+		if (quote == std::string::npos || (tag[quote] != '"' && tag[quote] != '\'')) continue;
+		std::size_t end = tag.find(tag[quote], quote + 1);
+		if (end == std::string::npos) continue;
+		return decode_entities(tag.substr(quote + 1, end - quote - 1));
+	}
+	return "";
+}
+
+bool is_element(const std::string& tag, const char* name) {
+	std::size_t length = std::strlen(name);
+	return tag.compare(0, length, name) == 0 && (tag.size() == length || std::isspace(static_cast<unsigned char>(tag[length])) || tag[length] == '/');
+}
+
+bool is_board_line(const std::string& line) {
+	bool wall = false;
+	for (char c : line) {
+		switch (c) {
+		case '#':
+			wall = true;
+			break;
+		case ' ':
+		case '\t':
+		case '-':
+		case '_':
+		case '.':
+		case '$':
+		case '*':
+		case '@':
+		case '+':
+		case 'p':
+		case 'P':
+		case 'b':
+		case 'B':
+			break;
+		default:
+			return false;
+		}
+	}
+	return wall;
+}
+
+// Level understands the classic characters only, so the XSB variants are mapped onto them
+// here, once for both readers.
+std::string board_row(const std::string& line) {
+	std::string row = line;
+	for (char& c : row) {
+		switch (c) {
+		case '-':
+		case '_':
+		case '\t':
+			c = ' ';
+			break;
+		case 'p':
+			c = '@';
+			break;
+		case 'P':
+			c = '+';
+			break;
+		case 'b':
+			c = '$';
+			break;
+		case 'B':
+			c = '*';
+			break;
+		}
+	}
+	return row;
+}
+
+std::string trim(const std::string& text) {
+	std::size_t first = text.find_first_not_of(" \t");
+	if (first == std::string::npos) return "";
+	return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+// Smaller files are read on one thread.
+const std::size_t parallel_size = std::size_t(4) << 20;
+
+// Start of the first <Level element at or after from, or end.
+const char* find_level_tag(const char* from, const char* end) {
+	for (const char* p = from; (p = static_cast<const char*>(std::memchr(p, '<', end - p))) != nullptr; p++) {
+		if (end - p > 6 && std::memcmp(p + 1, "Level", 5) == 0 && (std::isspace(static_cast<unsigned char>(p[6])) || p[6] == '>' || p[6] == '/')) {
+			return p;
+		}
+	}
+	return end;
+}
+
+bool is_plain_slc(const MappedFile& file) {
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+	if (file.size() >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+		return false;
+	}
+	for (std::size_t i = 0; i < file.size(); i++) {
+		unsigned char c = data[i];
+		bool bom = c == 0xef || c == 0xbb || c == 0xbf;
+		if (!bom && c != ' ' && c != '\t' && c != '\r' && c != '\n') return c == '<';
+	}
+	return false;
+}
+
+// Size of the part of a mapped .slc file each thread parses per window.
+const std::size_t chunk_size = std::size_t(1) << 20;
+
+}
+
+SlcSource::SlcSource(ByteReader reader, bool number_untitled) : reader(std::move(reader)), number_untitled(number_untitled) {}
+
+// Reads the character data up to the next tag and the tag itself, without the angle
+// brackets. Comments, processing instructions and CDATA markers are skipped.
+bool SlcSource::read_tag(std::string& tag, std::string& text) {
+	text.clear();
+	if (!reader.read_until('<', text)) return false;
+	tag.clear();
+	if (!reader.read_until('>', tag)) return false;
+	if (tag.compare(0, 3, "!--") == 0) {
+		// A comment may contain '>', so it only ends at "-->".
+		while (tag.size() < 5 || tag.compare(tag.size() - 2, 2, "--") != 0) {
+			tag += '>';
+			if (!reader.read_until('>', tag)) return false;
+		}
+	}
+	return true;
+}
+
+std::optional<Level> SlcSource::next() {
+	std::string tag;
+	std::string text;
+	std::string data;
+	std::string title;
+	bool in_level = false;
+	while (read_tag(tag, text)) {
+		if (!in_level) {
+			if (is_element(tag, "Level")) {
+				in_level = true;
+				title = attribute(tag, "Id");
+				data.clear();
+				if (tag.back() == '/') in_level = false;
+			}
+			continue;
+		}
+		if (is_element(tag, "/L")) {
+			data += board_row(decode_entities(text));
+			data += '\n';
+		}
+		else if (is_element(tag, "/Level")) {
+			count++;
+			Level level(data);
+			level.set_title(title.empty() && number_untitled ? std::to_string(count) : title);
+			return level;
+		}
+	}
+	if (in_level) {
+		throw std::runtime_error("Unterminated Level element in level file");
+	}
+	return std::nullopt;
+}
+
+XsbSource::XsbSource(ByteReader reader) : reader(std::move(reader)) {}
+
+std::optional<Level> XsbSource::next() {
+	std::string line;
+	std::string data;
+	std::string title;
+	bool in_board = false;
+	for (;;) {
+		bool have = has_pending;
+		if (has_pending) {
+			line = pending_line;
+			has_pending = false;
+		}
+		else {
+			have = reader.read_line(line);
+		}
+		if (!have) break;
+
+		if (is_board_line(line)) {
+			if (!in_board && !data.empty()) {
+				// Start of the next level: finish the current one first.
+				pending_line = line;
+				has_pending = true;
+				break;
+			}
+			if (!in_board) {
+				title = pending_title;
+				pending_title.clear();
+			}
+			in_board = true;
+			data += board_row(line);
+			data += '\n';
+			continue;
+		}
+
+		in_board = false;
+		std::string text = trim(line);
+		if (text.empty()) continue;
+		if (text.compare(0, 6, "Title:") == 0) {
+			std::string name = trim(text.substr(6));
+			if (!data.empty()) {
+				title = name;
+			}
+			else {
+				pending_title = name;
+			}
+		}
+		else if (text[0] == ';') {
+			pending_title = trim(text.substr(1));
+		}
+		else if (text.find(':') == std::string::npos) {
+			pending_title = text;
+		}
+	}
+
+	if (data.empty()) {
+		return std::nullopt;
+	}
+	count++;
+	Level level(data);
+	level.set_title(title.empty() ? std::to_string(count) : title);
+	return level;
+}
+
+ParallelSlcSource::ParallelSlcSource(std::unique_ptr<MappedFile> file, unsigned threads)
+	: file(std::move(file)), threads(std::max(1u, threads)) {
+	position = this->file->data();
+}
+
+std::optional<Level> ParallelSlcSource::next() {
+	if (ready_pos == ready.size()) {
+		ready.clear();
+		ready_pos = 0;
+		while (ready.empty() && position != file->data() + file->size()) {
+			parse_window();
+		}
+		if (ready.empty()) {
+			return std::nullopt;
+		}
+	}
+	count++;
+	Level level = std::move(ready[ready_pos++]);
+	if (level.get_title().empty()) {
+		level.set_title(std::to_string(count));
+	}
+	return level;
+}
+
+// Every chunk but the first of the file starts at a <Level tag, so each is a run of
+// whole levels that SlcSource can read on its own. The chunks of a window are parsed in
+// any order and joined in file order.
+void ParallelSlcSource::parse_window() {
+	const char* end = file->data() + file->size();
+	std::vector<const char*> bounds = { position };
+	for (unsigned i = 1; i <= threads; i++) {
+		const char* at = static_cast<std::size_t>(end - position) > chunk_size * i
+			? find_level_tag(std::max(position + chunk_size * i, bounds.back() + 1), end) : end;
+		bounds.push_back(at);
+		if (at == end) break;
+	}
+	position = bounds.back();
+
+	std::size_t chunks = bounds.size() - 1;
+	std::vector<std::vector<Level>> parsed(chunks);
+	std::atomic<std::size_t> next(0);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	auto worker = [&]() {
+		try {
+			for (std::size_t i = next++; i < chunks; i = next++) {
+				SlcSource source(ByteReader(std::make_unique<MemoryStream>(bounds[i], bounds[i + 1])), false);
+				while (std::optional<Level> level = source.next()) {
+					parsed[i].push_back(std::move(*level));
+				}
+			}
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error) error = std::current_exception();
+			next = chunks;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (std::size_t i = 1; i < chunks; i++) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : pool) {
+		thread.join();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	for (auto& chunk : parsed) {
+		std::move(chunk.begin(), chunk.end(), std::back_inserter(ready));
+	}
+}
+
+std::unique_ptr<LevelSource> open_level_source(const std::string& path, unsigned threads) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	std::error_code error;
+	if (threads > 1 && std::filesystem::file_size(path, error) >= parallel_size && !error) {
+		auto file = std::make_unique<MappedFile>(path);
+		if (is_plain_slc(*file)) {
+			return std::make_unique<ParallelSlcSource>(std::move(file), threads);
+		}
+	}
+	ByteReader reader(open_byte_stream(path));
+	if (reader.sniff() == '<') {
+		return std::make_unique<SlcSource>(std::move(reader));
+	}
+	return std::make_unique<XsbSource>(std::move(reader));
+}
\ No newline at end of file
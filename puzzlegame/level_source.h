@@ -0,0 +1,76 @@
+#ifndef LEVEL_SOURCE_H_
+#define LEVEL_SOURCE_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "level.h"
+#include "stream.h"
+
+// Yields the levels of a pack one at a time, so a pack of any size is read in
+// constant memory. Levels without a title are named after their position.
+class LevelSource {
+public:
+	virtual ~LevelSource() = default;
+	virtual std::optional<Level> next() = 0;
+};
+
+// .slc XML: every <Level Id="..."> element with one <L> element per row. Without
+// number_untitled, levels without an Id keep an empty title.
+class SlcSource : public LevelSource {
+public:
+	explicit SlcSource(ByteReader reader, bool number_untitled = true);
+
+	std::optional<Level> next() override;
+
+private:
+	ByteReader reader;
+	bool number_untitled;
+	std::size_t count = 0;
+
+	bool read_tag(std::string& tag, std::string& text);
+};
+
+// XSB text: boards of wall/floor/goal/box/player characters separated by other lines.
+// A "; name" or plain text line before a board, or a "Title: name" line after it,
+// names the level.
+class XsbSource : public LevelSource {
+public:
+	explicit XsbSource(ByteReader reader);
+
+	std::optional<Level> next() override;
+
+private:
+	ByteReader reader;
+	std::size_t count = 0;
+	std::string pending_line;
+	bool has_pending = false;
+	std::string pending_title;
+};
+
+// Large uncompressed .slc file, mapped and split at <Level> tags into chunks of about
+// 1 MB. One chunk per thread is parsed at a time, so only that window of levels is held.
+class ParallelSlcSource : public LevelSource {
+public:
+	ParallelSlcSource(std::unique_ptr<MappedFile> file, unsigned threads);
+
+	std::optional<Level> next() override;
+
+private:
+	std::unique_ptr<MappedFile> file;
+	unsigned threads;
+	const char* position = nullptr;
+	std::vector<Level> ready;
+	std::size_t ready_pos = 0;
+	std::size_t count = 0;
+
+	void parse_window();
+};
+
+// Picks the reader by content: gzip is unpacked first, then XML goes to SlcSource and
+// everything else to XsbSource. With more than one thread (0 = all cores), uncompressed
+// .slc files of a few MB and more are read by a ParallelSlcSource instead.
+std::unique_ptr<LevelSource> open_level_source(const std::string& path, unsigned threads = 1);
+
+#endif
@@ -5,60 +5,358 @@
 #include <iostream>
 #include <fstream>
 #include <windows.h>
-#include <comutil.h>
 #include <sstream>
 #include "level.h"
+#include "deadlock.h"
+#include "analyzer.h"
+#include "benchmark.h"
+#include "dedupe.h"
+#include "generator.h"
+#include "hint.h"
+#include "input_log.h"
+#include "level_source.h"
+#include "level_select.h"
+#include "solution_cache.h"
+#include "telemetry.h"
 #include "cmdparser.h"
-#include <msxml6.h>
-#import <msxml6.dll>
 #include <chrono>
 #include <thread>
 #include "tile.h"
 #include "renderer.h"
 #include <future>
-#include <objbase.h>
 #include <iterator>
 #include <optional>
 
 
 
 bool isFileEmpty(const std::string& filename);
-std::vector<Level> load_slc_file(const std::string& path);
-std::string BSTRToString(BSTR bstr);
-std::vector<Level> ParseLevels(MSXML2::IXMLDOMNodePtr pLevelCollection);
+std::vector<std::string> split_list(const std::string& list, char separator);
 SDL_Window* create_window(int width, int height, bool fullscreen);
-Tile load_tileset(SDL_Renderer* renderer, const std::string& path, int width, int height, int effective_height, int offset, int png_width, int png_height, int screen_width, int screen_height);
+void destroy_screen(SDL_Window* window, SDL_Surface* screen);
 TTF_Font* load_font(const std::string& path, int size);
-void handle_event(const SDL_Event& event, bool& running, Level& level, const Level& referenceLevel, bool& skipLevel);
+void handle_event(const SDL_Event& event, bool& running, Level& level, const Level& referenceLevel, bool& skipLevel, bool& selecting, HintSolver& hint);
 void render_frame(SDL_Renderer* renderer, Renderer& render, Level& level);
+void render_select_frame(SDL_Renderer* renderer, Renderer& render, LevelSelect& select);
 
-template <typename Iterator>
-std::optional<typename Iterator::value_type> next_level(Iterator& it, const Iterator& end);
+std::optional<Level> next_level(LevelSource& source, const DeadlockDatabase* deadlocks);
 
 
 int main(int argc, char** argv)
 {
 	CmdParser parser;
 
-	parser.addSwitch("--input", "-i", "input xml level file", "");
+	parser.addSwitch("--input", "-i", "input level file (.slc, .xsb/.txt, optionally gzip compressed)", "");
 	parser.addSwitch("--width", "-w", "screen width", "1920");
 	parser.addSwitch("--height", "-h", "screen height", "1080");
 	parser.addSwitch("--fullscreen", "-f", "fullscreen mode", "false", false);
+	parser.addSwitch("--deadlock-db", "-d", "deadlock pattern database file", "");
+	parser.addSwitch("--build-deadlock-db", "-b", "generate the deadlock pattern database file and exit", "");
+	parser.addSwitch("--dedupe", "-u", "comma separated level files to scan for duplicate levels", "");
+	parser.addSwitch("--threads", "-t", "worker threads for batch modes (0 = all cores)", "0");
+	parser.addSwitch("--generate", "-g", "append generated levels to this .slc file and exit", "");
+	parser.addSwitch("--count", "-c", "number of levels to generate", "10");
+	parser.addSwitch("--boxes", "-x", "boxes per generated level", "3");
+	parser.addSwitch("--room", "-r", "generated room size as WIDTHxHEIGHT", "9x9");
+	parser.addSwitch("--method", "-m", "generator method: reverse or template", "reverse");
+	parser.addSwitch("--seed", "-s", "generator random seed", "1");
+	parser.addSwitch("--analyze", "-a", "write per level metrics of the input file to this .csv or .json file and exit", "");
+	parser.addSwitch("--bench-solver", "-B", "solve every level of the input file on one thread and report throughput", "false", true);
+	parser.addSwitch("--bench-sessions", "-j", "step this many concurrent sessions of the input levels with random moves and report session steps/s (0 = off)", "0");
+	parser.addSwitch("--bench-steps", "-N", "play this many random moves on every input level and report Level::step throughput per board width class (0 = off)", "0");
+	parser.addSwitch("--portfolio", "-P", "race several solver strategies on --threads threads for every level of the input file and report per strategy wins", "false", true);
+	parser.addSwitch("--portfolio-optimal", "-o", "only let a push-optimal solution end a --portfolio race early", "false", true);
+	parser.addSwitch("--max-nodes", "-n", "solver node limit per level in batch modes and for hints (0 = unlimited)", "200000");
+	parser.addSwitch("--cache", "-k", "solution cache file used by the analyzer and hints", "solutions.cache");
+	parser.addSwitch("--no-cache", "-K", "do not read or write the solution cache", "false", true);
+	parser.addSwitch("--scratch-dir", "-S", "directory for the disk based breadth-first solver in batch modes (empty = in-memory A*)", "");
+	parser.addSwitch("--memory-budget", "-M", "memory budget in MB of the disk based solver, shared by the worker threads", "1024");
+	parser.addSwitch("--no-corrals", "-C", "do not restrict the solver to the pushes into a PI-corral in batch modes", "false", true);
+	parser.addSwitch("--macros", "-T", "push boxes through tunnels and into the goal room as single moves in batch modes (faster, not push-optimal)", "false", true);
+	parser.addSwitch("--telemetry", "-O", "while the analyzer or solver benchmark runs, keep live solver counters per thread in this Prometheus text file", "");
+	parser.addSwitch("--telemetry-interval", "-I", "milliseconds between telemetry file updates", "1000");
+	parser.addSwitch("--record", "-R", "record the input and level switches of this session to a file", "");
+	parser.addSwitch("--replay", "-p", "play a recorded session back as fast as possible and report frame times", "");
+	parser.addSwitch("--realtime", "-e", "replay at the recorded speed", "false", true);
+	parser.addSwitch("--headless", "-H", "replay without a window, rendering into an off-screen surface", "false", true);
 	parser.parse(argc, argv);
 	std::string inputFile = parser.value("input");
 	int width = parser.value_to_int("width");
 	int height = parser.value_to_int("height");
 	bool fullscreen = parser.value_to_bool("fullscreen");
+	std::string deadlockFile = parser.value("deadlock-db");
+	std::string buildDeadlockFile = parser.value("build-deadlock-db");
+	std::string dedupeFiles = parser.value("dedupe");
+	std::string cacheFile = parser.value_to_bool("no-cache") ? "" : parser.value("cache");
+	int threads = parser.value_to_int("threads");
+	if (threads <= 0) {
+		threads = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	std::string scratchDir = parser.value("scratch-dir");
+	std::size_t memoryBudget = static_cast<std::size_t>(std::max(1, parser.value_to_int("memory-budget"))) << 20;
+	bool macros = parser.value_to_bool("macros");
+	bool corrals = !parser.value_to_bool("no-corrals");
+	std::string telemetryFile = parser.value("telemetry");
+	std::chrono::milliseconds telemetryInterval(std::max(10, parser.value_to_int("telemetry-interval")));
+	std::string recordFile = parser.value("record");
+	std::string replayFile = parser.value("replay");
+	bool headless = parser.value_to_bool("headless");
+
+	if (buildDeadlockFile.size() != 0) {
+		try {
+			std::size_t patterns = DeadlockDatabase::generate(buildDeadlockFile);
+			std::cout << "wrote " << patterns << " deadlock patterns to " << buildDeadlockFile << std::endl;
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+	std::string generateFile = parser.value("generate");
+	if (generateFile.size() != 0) {
+		try {
+			std::unique_ptr<DeadlockDatabase> generatorDeadlocks;
+			if (deadlockFile.size() != 0) {
+				generatorDeadlocks = std::make_unique<DeadlockDatabase>(deadlockFile);
+			}
+			GeneratorOptions options;
+			std::vector<std::string> room = split_list(parser.value("room"), 'x');
+			if (room.size() == 2 && is_number(room[0]) && is_number(room[1])) {
+				options.width = std::stoi(room[0]);
+				options.height = std::stoi(room[1]);
+			}
+			options.method = parser.value("method") == "template" ? GeneratorMethod::Templates : GeneratorMethod::ReversePlay;
+			options.count = std::max(1, parser.value_to_int("count"));
+			options.boxes = std::max(1, parser.value_to_int("boxes"));
+			options.seed = static_cast<uint64_t>(std::max(0, parser.value_to_int("seed")));
+			options.threads = threads;
+			options.max_nodes = static_cast<uint64_t>(std::max(0, parser.value_to_int("max-nodes")));
+			options.deadlocks = generatorDeadlocks.get();
+
+			LevelGenerator generator(options);
+			std::vector<GeneratedLevel> generated = generator.run();
+			append_slc_levels(generateFile, generated, "Generated", "gen-" + std::to_string(options.seed) + "-");
+			const GeneratorStats& stats = generator.get_stats();
+			std::cout << "generated " << generated.size() << " levels from " << stats.candidates << " candidates in "
+				<< stats.seconds << "s (" << (stats.seconds > 0.0 ? generated.size() * 60.0 / stats.seconds : 0.0)
+				<< " levels/min)" << std::endl;
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (dedupeFiles.size() != 0) {
+		try {
+			LevelDeduplicator deduplicator([threads](const std::string& path) { return open_level_source(path, threads); }, threads);
+			DedupeStats stats = deduplicator.run(split_list(dedupeFiles, ','), std::cout);
+			std::cout << stats.files << " files, " << stats.levels << " levels, " << stats.unique << " unique, "
+				<< stats.duplicates << " duplicates in " << stats.seconds << "s" << std::endl;
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
 	if (inputFile.size() == 0) {
-		std::cout << "error: input xml level file must be provided" << std::endl;
+		std::cout << "error: input level file must be provided" << std::endl;
 		return -1;
 	}
 
+	if (parser.value_to_bool("bench-solver")) {
+		try {
+			std::unique_ptr<DeadlockDatabase> benchDeadlocks;
+			if (deadlockFile.size() != 0) {
+				benchDeadlocks = std::make_unique<DeadlockDatabase>(deadlockFile);
+			}
+			BenchmarkOptions options;
+			options.max_nodes = static_cast<uint64_t>(std::max(0, parser.value_to_int("max-nodes")));
+			options.deadlocks = benchDeadlocks.get();
+			options.scratch_dir = scratchDir;
+			options.memory_budget = memoryBudget;
+			options.macros = macros;
+			options.corrals = corrals;
+			std::unique_ptr<TelemetryPublisher> telemetry;
+			if (telemetryFile.size() != 0) {
+				telemetry = std::make_unique<TelemetryPublisher>(telemetryFile, telemetryInterval, 1);
+			}
+			options.telemetry = telemetry.get();
+			std::unique_ptr<LevelSource> source = open_level_source(inputFile, threads);
+			benchmark_solver(*source, options, std::cout);
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (parser.value_to_bool("portfolio")) {
+		try {
+			std::unique_ptr<DeadlockDatabase> portfolioDeadlocks;
+			if (deadlockFile.size() != 0) {
+				portfolioDeadlocks = std::make_unique<DeadlockDatabase>(deadlockFile);
+			}
+			PortfolioOptions options;
+			options.threads = static_cast<unsigned>(threads);
+			options.max_nodes = static_cast<uint64_t>(std::max(0, parser.value_to_int("max-nodes")));
+			options.deadlocks = portfolioDeadlocks.get();
+			options.require_optimal = parser.value_to_bool("portfolio-optimal");
+			std::unique_ptr<LevelSource> source = open_level_source(inputFile, threads);
+			benchmark_portfolio(*source, options, std::cout);
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	int benchSessions = parser.value_to_int("bench-sessions");
+	if (benchSessions > 0) {
+		try {
+			SessionBenchmarkOptions options;
+			options.sessions = static_cast<std::size_t>(benchSessions);
+			std::unique_ptr<LevelSource> source = open_level_source(inputFile, threads);
+			benchmark_sessions(*source, options, std::cout);
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	int benchSteps = parser.value_to_int("bench-steps");
+	if (benchSteps > 0) {
+		try {
+			StepBenchmarkOptions options;
+			options.steps = static_cast<uint64_t>(benchSteps);
+			std::unique_ptr<LevelSource> source = open_level_source(inputFile, threads);
+			benchmark_steps(*source, options, std::cout);
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::string analyzeFile = parser.value("analyze");
+	if (analyzeFile.size() != 0) {
+		try {
+			std::unique_ptr<DeadlockDatabase> analyzerDeadlocks;
+			if (deadlockFile.size() != 0) {
+				analyzerDeadlocks = std::make_unique<DeadlockDatabase>(deadlockFile);
+			}
+			std::unique_ptr<SolutionCache> analyzerCache;
+			if (cacheFile.size() != 0) {
+				analyzerCache = std::make_unique<SolutionCache>(cacheFile);
+			}
+			AnalyzerOptions options;
+			options.threads = threads;
+			options.max_nodes = static_cast<uint64_t>(std::max(0, parser.value_to_int("max-nodes")));
+			options.deadlocks = analyzerDeadlocks.get();
+			options.cache = analyzerCache.get();
+			options.scratch_dir = scratchDir;
+			options.memory_budget = memoryBudget / static_cast<std::size_t>(threads);
+			options.macros = macros;
+			options.corrals = corrals;
+			std::unique_ptr<TelemetryPublisher> telemetry;
+			if (telemetryFile.size() != 0) {
+				telemetry = std::make_unique<TelemetryPublisher>(telemetryFile, telemetryInterval, static_cast<unsigned>(threads));
+			}
+			options.telemetry = telemetry.get();
+
+			auto start = std::chrono::steady_clock::now();
+			std::unique_ptr<LevelSource> source = open_level_source(inputFile, threads);
+			std::vector<LevelMetrics> metrics = analyze_levels(*source, options);
+			telemetry.reset();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::ofstream out(analyzeFile, std::ios::trunc);
+			if (!out.is_open()) {
+				throw std::runtime_error("Failed to create metrics file: " + analyzeFile);
+			}
+			bool json = analyzeFile.size() >= 5 && analyzeFile.compare(analyzeFile.size() - 5, 5, ".json") == 0;
+			if (json) {
+				write_metrics_json(out, metrics);
+			}
+			else {
+				write_metrics_csv(out, metrics);
+			}
+			std::cout << "analyzed " << metrics.size() << " levels in " << seconds << "s" << std::endl;
+			if (analyzerCache) {
+				CacheStats stats = analyzerCache->get_stats();
+				std::cout << "cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.entries << " entries, "
+					<< stats.file_bytes << " bytes" << std::endl;
+			}
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
 	bool empty = isFileEmpty(inputFile);
-	std::vector<Level> levels = load_slc_file(inputFile);
+	std::unique_ptr<LevelSource> levels;
+	try {
+		levels = open_level_source(inputFile);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<DeadlockDatabase> deadlocks;
+	if (deadlockFile.size() != 0) {
+		try {
+			deadlocks = std::make_unique<DeadlockDatabase>(deadlockFile);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::unique_ptr<SolutionCache> cache;
+	if (cacheFile.size() != 0) {
+		try {
+			cache = std::make_unique<SolutionCache>(cacheFile);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
 
 
-	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+	if (headless && replayFile.size() == 0) {
+		std::cout << "error: --headless needs a recording to --replay" << std::endl;
+		return -1;
+	}
+	std::unique_ptr<InputRecorder> recorder;
+	std::unique_ptr<InputReplay> replay;
+	try {
+		if (replayFile.size() != 0) {
+			replay = std::make_unique<InputReplay>(replayFile, parser.value_to_bool("realtime"));
+		}
+		if (recordFile.size() != 0) {
+			recorder = std::make_unique<InputRecorder>(recordFile);
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+
+	if (SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) != 0) {
 		std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
 		return 1;
 	}
@@ -76,12 +374,20 @@ int main(int argc, char** argv)
 	}
 
 	try {
-		SDL_Window* window = create_window(width, height, fullscreen);
-
-		SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+		SDL_Window* window = nullptr;
+		SDL_Surface* screen = nullptr;
+		SDL_Renderer* renderer = nullptr;
+		if (headless) {
+			screen = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+			renderer = screen ? SDL_CreateSoftwareRenderer(screen) : nullptr;
+		}
+		else {
+			window = create_window(width, height, fullscreen);
+			renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+		}
 		if (!renderer) {
 			std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-			SDL_DestroyWindow(window);
+			destroy_screen(window, screen);
 			SDL_Quit();
 			return 1;
 		}
@@ -95,21 +401,18 @@ int main(int argc, char** argv)
 		if (!texture) {
 			std::cerr << "Texture could not be created! SDL_Error: " << SDL_GetError() << std::endl;
 			SDL_DestroyRenderer(renderer);
-			SDL_DestroyWindow(window);
+			destroy_screen(window, screen);
 			SDL_Quit();
 			return 1;
 		}
 
 		try {
-			Tile bigTileSet = load_tileset(renderer, "Tilesheet/sokoban_tilesheet@2.png", 128, 128, 80, 48, 1664, 1024, width, height);
-			Tile smallTileSet = load_tileset(renderer, "Tilesheet/sokoban_tilesheet.png", 64, 64, 40, 24, 832, 512, width, height);
+			TileCache tiles(renderer, "Tilesheet/sokoban_tilesheet@2.png", 128, 128, 80, 48, width, height, Renderer::sprites());
 			std::unique_ptr<TTF_Font, decltype(&TTF_CloseFont)> font(load_font("roboto-regular.ttf", 20), TTF_CloseFont);
 
-			Renderer render(renderer, bigTileSet, smallTileSet, font.get());
+			Renderer render(renderer, tiles, font.get());
 
-			auto levelsIt = levels.begin();
-			auto levelsEnd = levels.end();
-			std::optional<Level> optionalLevel = next_level(levelsIt, levelsEnd);
+			std::optional<Level> optionalLevel = next_level(*levels, deadlocks.get());
 
 			if (optionalLevel) {
 
@@ -119,26 +422,104 @@ int main(int argc, char** argv)
 
 				bool running = true;
 				bool skipLevel = false;
+				bool selecting = false;
+				bool fromSelect = false;
+				std::size_t levelIndex = 0;
 				SDL_Event event;
+				HintSolver hint(deadlocks.get(), cache.get(), static_cast<uint64_t>(std::max(0, parser.value_to_int("max-nodes"))));
+				LevelSelect select(inputFile, width, height, replay != nullptr);
+				const auto frameBudget = std::chrono::microseconds(16667);
+				uint32_t frame = 0;
+				// Input comes from the replay instead of SDL when one is given; both sources are recorded.
+				auto poll_event = [&](SDL_Event& polled) {
+					bool got = replay ? replay->poll(frame, polled) : SDL_PollEvent(&polled) != 0;
+					if (got && recorder) {
+						recorder->record_event(frame, polled);
+					}
+					return got;
+				};
+				auto switched_level = [&](std::size_t index, const Level& level) {
+					if (recorder) {
+						recorder->record_level(frame, index, level.get_title());
+					}
+					if (replay) {
+						replay->check_level(frame, index, level.get_title());
+					}
+				};
+				switched_level(levelIndex, referenceLevel);
 
 				while (running) {
-					if (currentLevel.is_completed() || skipLevel) {
-						optionalLevel = next_level(levelsIt, levelsEnd);
-						if (optionalLevel) {
-							referenceLevel = *optionalLevel;
-							currentLevel = referenceLevel.clone();
-							skipLevel = false;
-						}
-						else {
-							break;
+					auto frameStart = std::chrono::steady_clock::now();
+					if (selecting) {
+						render_select_frame(renderer, render, select);
+						bool closed = false;
+						while (!closed && poll_event(event)) {
+							std::optional<std::size_t> picked = select.handle_event(event, closed);
+							// The recorded pick wins, as the recording's selection was clamped to the levels loaded then.
+							if (picked && replay) {
+								picked = replay->pending_level().value_or(*picked);
+							}
+							running = running && event.type != SDL_QUIT;
+							if (picked && (optionalLevel = select.get_level(*picked))) {
+								optionalLevel->set_deadlock_database(deadlocks.get());
+								levelIndex = *picked;
+								fromSelect = true;
+								referenceLevel = *optionalLevel;
+								currentLevel = referenceLevel.clone();
+								switched_level(levelIndex, referenceLevel);
+							}
 						}
+						selecting = !closed;
 					}
+					else {
+						if (currentLevel.is_completed() || skipLevel) {
+							hint.cancel();
+							levelIndex++;
+							if (fromSelect) {
+								optionalLevel = select.get_level(levelIndex);
+								if (optionalLevel) {
+									optionalLevel->set_deadlock_database(deadlocks.get());
+								}
+							}
+							else {
+								optionalLevel = next_level(*levels, deadlocks.get());
+							}
+							if (optionalLevel) {
+								referenceLevel = *optionalLevel;
+								currentLevel = referenceLevel.clone();
+								skipLevel = false;
+								switched_level(levelIndex, referenceLevel);
+							}
+							else {
+								break;
+							}
+						}
+
+						hint.poll(currentLevel);
+						render.set_hint(hint.get_move(), hint.get_status());
+						render_frame(renderer, render, currentLevel);
 
-					render_frame(renderer, render, currentLevel);
+						while (!selecting && poll_event(event)) {
+							render.handle_event(event);
+							handle_event(event, running, currentLevel, referenceLevel, skipLevel, selecting, hint);
+						}
+						if (selecting) {
+							select.open(levelIndex);
+						}
+					}
 
-					while (SDL_PollEvent(&event)) {
-						handle_event(event, running, currentLevel, referenceLevel, skipLevel);
+					auto frameTime = std::chrono::steady_clock::now() - frameStart;
+					if (replay) {
+						replay->frame_done(std::chrono::duration<double>(frameTime).count());
+						running = running && !replay->finished();
+					}
+					if ((!replay || replay->is_realtime()) && frameTime < frameBudget) {
+						std::this_thread::sleep_for(frameBudget - frameTime);
 					}
+					frame++;
+				}
+				if (replay) {
+					replay->report(std::cout);
 				}
 			}
 		}
@@ -147,7 +528,7 @@ int main(int argc, char** argv)
 		}
 
 		SDL_DestroyRenderer(renderer);
-		SDL_DestroyWindow(window);
+		destroy_screen(window, screen);
 
 	}
 	catch (const std::exception& e) {
@@ -164,69 +545,6 @@ int main(int argc, char** argv)
 	return 0;
 }
 
-std::vector<Level> load_slc_file(const std::string& path) {
-	std::vector<Level> levels;
-
-
-	MSXML2::IXMLDOMDocument2Ptr doc;
-	HRESULT hr = CoInitialize(NULL);
-	if (FAILED(hr)) {
-		throw std::runtime_error("Failed to initialize COM");
-	}
-	hr = doc.CreateInstance(__uuidof(MSXML2::DOMDocument60), NULL, CLSCTX_INPROC_SERVER);
-
-	if (FAILED(hr)) {
-		std::cerr << "FAILED(hr)" << hr << std::endl;
-	}
-	doc->PutpreserveWhiteSpace(VARIANT_TRUE);
-
-	VARIANT_BOOL success = VARIANT_FALSE;
-
-	VARIANT filename;
-
-	filename.vt = VT_BSTR;
-
-	std::cout << path.c_str() << std::endl;
-
-	filename.bstrVal = _bstr_t(path.c_str());
-
-	VARIANT_BOOL load_success = doc->load(filename);
-	if (load_success != VARIANT_TRUE) {
-
-		_com_error error(hr);
-		std::cerr << "COM Error during SLC file loading: " << error.ErrorMessage() << std::endl;
-		std::cout << success << std::endl;
-		std::cerr << "FAILED(hr) = 0x" << std::hex << hr << std::endl;
-		std::cerr << "error" << std::endl;
-		std::cerr << "Failed to load XML" << std::endl;
-		MSXML2::IXMLDOMParseErrorPtr pError = doc->parseError;
-		std::wcerr << L"Error: " << pError->reason << std::endl;
-		pError.Release();
-	}
-
-
-	MSXML2::IXMLDOMNodePtr root = doc->documentElement;
-	if (!root) {
-		std::cerr << "No root element found" << std::endl;
-
-	}
-
-	std::string level_data;
-	std::string level_title;
-	bool reading_level = false;
-
-	MSXML2::IXMLDOMNodePtr pLevelCollection;
-	MSXML2::IXMLDOMNodeListPtr pChildNodes = root->selectNodes(_bstr_t(L"LevelCollection"));
-	pLevelCollection = pChildNodes->item[0];
-
-	levels = ParseLevels(pLevelCollection);
-	pChildNodes.Release();
-	pLevelCollection.Release();
-	root.Release();
-	doc.Release();
-	CoUninitialize();
-	return levels;
-}
 
 bool isFileEmpty(const std::string& filename) {
 	std::ifstream file(filename, std::ios::binary | std::ios::ate);
@@ -241,77 +559,20 @@ bool isFileEmpty(const std::string& filename) {
 	return  0;
 }
 
-std::string BSTRToString(BSTR bstr) {
-
-	if (!bstr) return "";
-
-	int len = WideCharToMultiByte(CP_UTF8, 0, bstr, -1, NULL, 0, NULL, NULL);
-
-	std::string str(len, 0);
-	WideCharToMultiByte(CP_UTF8, 0, bstr, -1, &str[0], len, NULL, NULL);
-
-	return str;
-}
-
-std::vector<Level> ParseLevels(MSXML2::IXMLDOMNodePtr pLevelCollection) {
-	std::vector<Level> levels;
-
-	if (!pLevelCollection) return levels;
-
-	MSXML2::IXMLDOMNodeListPtr pLevelNodes = pLevelCollection->selectNodes(_bstr_t(L"Level"));
-	if (!pLevelNodes) return levels;
-
-	long length;
-	pLevelNodes->get_length(&length);
-	for (long i = 0; i < length; ++i) {
-		MSXML2::IXMLDOMNodePtr pLevelNode = pLevelNodes->item[i];
-		if (!pLevelNode) continue;
-
-		std::string levelData;
-		std::string levelTitle;
-
-		MSXML2::IXMLDOMNamedNodeMapPtr pAttributes = pLevelNode->attributes;
-		if (pAttributes) {
-			MSXML2::IXMLDOMNodePtr pIdAttr = pAttributes->getNamedItem(_bstr_t(L"Id"));
-			if (pIdAttr) {
-				BSTR bstrId;
-				pIdAttr->get_text(&bstrId);
-				levelTitle = BSTRToString(bstrId);
-				SysFreeString(bstrId);
-			}
-			pIdAttr.Release();
-		}
-
-		MSXML2::IXMLDOMNodeListPtr pChildNodes = pLevelNode->childNodes;
-		if (pChildNodes) {
-			long childLength;
-			pChildNodes->get_length(&childLength);
-			for (long j = 0; j < childLength; ++j) {
-				MSXML2::IXMLDOMNodePtr pChildNode = pChildNodes->item[j];
-				if (pChildNode && pChildNode->nodeType == NODE_ELEMENT) {
-					BSTR bstrText;
-					pChildNode->get_text(&bstrText);
-					levelData += BSTRToString(bstrText);
-					levelData += '\n';
-					SysFreeString(bstrText);
-				}
-				pChildNode.Release();
-			}
+std::vector<std::string> split_list(const std::string& list, char separator) {
+	std::vector<std::string> items;
+	std::istringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, separator)) {
+		if (!item.empty()) {
+			items.push_back(item);
 		}
-
-
-		Level level(levelData);
-		level.set_title(levelTitle);
-		levels.push_back(level);
-		pChildNodes.Release();
-		pAttributes.Release();
-		pLevelNode.Release();
 	}
-
-	pLevelNodes.Release();
-	return levels;
+	return items;
 }
 
+
+
 SDL_Window* create_window(int width, int height, bool fullscreen) {
 
 	Uint32 window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN;
@@ -341,21 +602,13 @@ SDL_Window* create_window(int width, int height, bool fullscreen) {
 	return window;
 }
 
-Tile load_tileset(SDL_Renderer* renderer, const std::string& path, int width, int height, int effective_height, int offset, int png_width, int png_height, int screen_width, int screen_height) {
-	SDL_Surface* surface = IMG_Load(path.c_str());
-	if (!surface) {
-		throw std::runtime_error("Failed to load image: " + path + ", SDL_Error: " + std::string(SDL_GetError()));
+void destroy_screen(SDL_Window* window, SDL_Surface* screen) {
+	if (window) {
+		SDL_DestroyWindow(window);
 	}
-
-	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-	SDL_FreeSurface(surface);
-
-	if (!texture) {
-		throw std::runtime_error("Failed to create texture from surface: SDL_Error: " + std::string(SDL_GetError()));
+	if (screen) {
+		SDL_FreeSurface(screen);
 	}
-
-	Tile tileset(texture, width, height, effective_height, offset, png_width, png_height, screen_width, screen_height);
-	return tileset;
 }
 
 TTF_Font* load_font(const std::string& path, int size) {
@@ -366,15 +619,14 @@ TTF_Font* load_font(const std::string& path, int size) {
 	return font;
 }
 
-template <typename Iterator>
-std::optional<typename Iterator::value_type> next_level(Iterator& it, const Iterator& end) {
-	if (it != end) {
-		return *(it++);
-	}
-	else {
-		return std::nullopt;
+std::optional<Level> next_level(LevelSource& source, const DeadlockDatabase* deadlocks) {
+	std::optional<Level> level = source.next();
+	if (level) {
+		level->set_deadlock_database(deadlocks);
 	}
+	return level;
 }
+
 void render_frame(SDL_Renderer* renderer, Renderer& render, Level& level) {
 	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 	SDL_RenderClear(renderer);
@@ -382,7 +634,14 @@ void render_frame(SDL_Renderer* renderer, Renderer& render, Level& level) {
 	SDL_RenderPresent(renderer);
 }
 
-void handle_event(const SDL_Event& event, bool& running, Level& level, const Level& referenceLevel, bool& skipLevel) {
+void render_select_frame(SDL_Renderer* renderer, Renderer& render, LevelSelect& select) {
+	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+	SDL_RenderClear(renderer);
+	select.render(renderer, render);
+	SDL_RenderPresent(renderer);
+}
+
+void handle_event(const SDL_Event& event, bool& running, Level& level, const Level& referenceLevel, bool& skipLevel, bool& selecting, HintSolver& hint) {
 	if (event.type == SDL_QUIT) {
 		running = false;
 	}
@@ -392,23 +651,36 @@ void handle_event(const SDL_Event& event, bool& running, Level& level, const Lev
 			running = false;
 			break;
 		case SDLK_LEFT:
+			hint.cancel();
 			level.step(Direction::Left);
 			break;
 		case SDLK_RIGHT:
+			hint.cancel();
 			level.step(Direction::Right);
 			break;
 		case SDLK_UP:
+			hint.cancel();
 			level.step(Direction::Up);
 			break;
 		case SDLK_DOWN:
+			hint.cancel();
 			level.step(Direction::Down);
 			break;
 		case SDLK_r:
+			hint.cancel();
 			level = referenceLevel.clone();
 			break;
 		case SDLK_n:
+			hint.cancel();
 			skipLevel = true;
 			break;
+		case SDLK_h:
+			hint.start(level);
+			break;
+		case SDLK_l:
+			hint.cancel();
+			selecting = true;
+			break;
 		default:
 			break;
 		}
@@ -0,0 +1,111 @@
+#include "portfolio.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+std::vector<PortfolioStrategy> default_strategies() {
+	std::vector<PortfolioStrategy> strategies(4);
+	strategies[0].name = "astar";
+	strategies[1].name = "astar-no-corrals";
+	strategies[1].options.corrals = false;
+	strategies[2].name = "weighted-macros";
+	strategies[2].options.weight = 3;
+	strategies[2].options.macros = true;
+	strategies[3].name = "greedy-macros";
+	strategies[3].options.weight = 0;
+	strategies[3].options.macros = true;
+	return strategies;
+}
+
+PortfolioSolver::PortfolioSolver(const std::vector<PortfolioStrategy>& strategies, const PortfolioOptions& options)
+	: strategies(strategies), options(options) {
+	if (strategies.empty()) {
+		throw std::runtime_error("Portfolio needs at least one strategy");
+	}
+	for (const auto& strategy : strategies) {
+		StrategyStats entry;
+		entry.name = strategy.name;
+		stats.push_back(entry);
+	}
+}
+
+// Ranks strategies by their smoothed win rate, so one that has not raced yet starts at
+// one half and a strategy that keeps losing drops below it.
+std::vector<std::size_t> PortfolioSolver::pick_strategies() {
+	std::vector<std::size_t> order(strategies.size());
+	for (std::size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::size_t threads = options.threads ? std::min<std::size_t>(options.threads, order.size()) : order.size();
+	if (threads == order.size()) {
+		return order;
+	}
+	auto score = [this](std::size_t i) { return (stats[i].wins + 1.0) / (stats[i].races + 2.0); };
+	std::stable_sort(order.begin(), order.end(), [&score](std::size_t a, std::size_t b) { return score(a) > score(b); });
+	if (threads > 1) {
+		std::size_t rest = order.size() - threads + 1;
+		std::swap(order[threads - 1], order[threads - 1 + rotation++ % rest]);
+	}
+	order.resize(threads);
+	return order;
+}
+
+PortfolioResult PortfolioSolver::solve(const Level& level) {
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::size_t> picked = pick_strategies();
+	std::atomic<bool> cancel(false);
+	std::mutex mutex;
+	PortfolioResult result;
+	PortfolioResult fallback;
+
+	auto race = [&](std::size_t strategy) {
+		SolverOptions solver_options = strategies[strategy].options;
+		solver_options.deadlocks = options.deadlocks;
+		solver_options.max_nodes = options.max_nodes;
+		solver_options.cancel = &cancel;
+		solver_options.progress = nullptr;
+		solver_options.telemetry = nullptr;
+		Solver solver(level, solver_options);
+		Solution solution = solver.solve();
+		const SolverStats& solver_stats = solver.get_stats();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		StrategyStats& entry = stats[strategy];
+		entry.races++;
+		entry.seconds += solver_stats.seconds;
+		result.nodes_expanded += solver_stats.nodes_expanded;
+		if (!solution.solved) {
+			return;
+		}
+		entry.solved++;
+		if (result.winner < 0 && (solution.optimal || !options.require_optimal)) {
+			result.winner = static_cast<int>(strategy);
+			result.solution = std::move(solution);
+			cancel = true;
+		}
+		else if (fallback.winner < 0) {
+			fallback.winner = static_cast<int>(strategy);
+			fallback.solution = std::move(solution);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (std::size_t i = 1; i < picked.size(); i++) {
+		pool.emplace_back(race, picked[i]);
+	}
+	race(picked[0]);
+	for (auto& thread : pool) {
+		thread.join();
+	}
+
+	if (result.winner < 0 && fallback.winner >= 0) {
+		result.winner = fallback.winner;
+		result.solution = std::move(fallback.solution);
+	}
+	if (result.winner >= 0) {
+		stats[result.winner].wins++;
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef PORTFOLIO_H_
+#define PORTFOLIO_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "level.h"
+#include "solver.h"
+
+class DeadlockDatabase;
+
+// One solver configuration of the portfolio. The portfolio fills in the deadlock
+// database, node limit and cancel flag.
+struct PortfolioStrategy {
+	std::string name;
+	SolverOptions options;
+};
+
+struct PortfolioOptions {
+	// Strategies raced per level; 0 races all of them.
+	unsigned threads = 0;
+	uint64_t max_nodes = 0;
+	const DeadlockDatabase* deadlocks = nullptr;
+	// Only a push-optimal solution ends the race early. A faster non-optimal one is kept
+	// in case no optimal strategy finishes.
+	bool require_optimal = false;
+};
+
+struct StrategyStats {
+	std::string name;
+	uint64_t races = 0;
+	uint64_t solved = 0;
+	uint64_t wins = 0;
+	double seconds = 0.0;
+};
+
+struct PortfolioResult {
+	Solution solution;
+	// Index of the strategy whose solution was taken, -1 when none solved the level.
+	int winner = -1;
+	double seconds = 0.0;
+	uint64_t nodes_expanded = 0;
+};
+
+// Optimal A* with and without PI-corrals, weighted A* and greedy best-first with macros.
+std::vector<PortfolioStrategy> default_strategies();
+
+// Races several solver configurations on the same level, one thread each, and stops the
+// others as soon as one has an acceptable answer. Wins are counted per strategy, and
+// when there are fewer threads than strategies the ones that won most so far get the
+// threads, with the last thread rotating through the rest so they keep a chance.
+class PortfolioSolver {
+public:
+	PortfolioSolver(const std::vector<PortfolioStrategy>& strategies, const PortfolioOptions& options);
+
+	PortfolioResult solve(const Level& level);
+
+	const std::vector<StrategyStats>& get_stats() const { return stats; }
+
+private:
+	std::vector<PortfolioStrategy> strategies;
+	PortfolioOptions options;
+	std::vector<StrategyStats> stats;
+	uint64_t rotation = 0;
+
+	std::vector<std::size_t> pick_strategies();
+};
+
+#endif
\ No newline at end of file
@@ -5,16 +5,31 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <SDL.h>
+#include "camera.h"
 #include "tile.h"
+#include "tile_cache.h"
 #include <SDL_ttf.h>
 #include <optional>
 #include "cmdparser.h"
 
 class Renderer {
 public:
-	Renderer(SDL_Renderer* renderer, const Tile& big_set, const Tile& small_set, TTF_Font* font)
-		: renderer(renderer), big_set(big_set), small_set(small_set), font(font) {}
+	// Sheet cells of every sprite render_screen draws.
+	static const std::vector<std::pair<int, int>>& sprites() {
+		static const std::vector<std::pair<int, int>> used = {
+			{ 10, 0 }, { 11, 0 }, { 7, 7 }, { 6, 0 }, { 6, 4 }, { 3, 6 }, { 0, 6 }, { 3, 4 }, { 0, 4 }
+		};
+		return used;
+	}
+
+	Renderer(SDL_Renderer* renderer, TileCache& tiles, TTF_Font* font)
+		: renderer(renderer), tiles(tiles), font(font),
+		camera(static_cast<double>(tiles.get_effective_height()) / tiles.get_width(),
+			static_cast<double>(tiles.get_offset()) / tiles.get_effective_height()) {}
 
 
 	void draw_text(const std::string& text, int x, int y, SDL_Color color, int text_width, int text_height) {
@@ -42,74 +57,130 @@ public:
 		SDL_RenderCopy(renderer, tileset.get_texture(), &src_rect, &dst_rect);
 	}
 
+	void draw_tile(const Tile& tileset, int col, int row, const SDL_Rect& dst_rect) {
+		SDL_Rect src_rect = tileset.get_tile_rect(col, row);
+		SDL_RenderCopy(renderer, tileset.get_texture(), &src_rect, &dst_rect);
+	}
+
+	void set_hint(const std::optional<Direction>& move, const std::string& status) {
+		hint_move = move;
+		hint_status = status;
+	}
+
+	void handle_event(const SDL_Event& event) {
+		if (event.type == SDL_KEYDOWN) {
+			switch (event.key.keysym.sym) {
+			case SDLK_PLUS:
+			case SDLK_EQUALS:
+			case SDLK_KP_PLUS:
+				camera.zoom_by(Camera::zoom_step);
+				break;
+			case SDLK_MINUS:
+			case SDLK_KP_MINUS:
+				camera.zoom_by(1.0 / Camera::zoom_step);
+				break;
+			case SDLK_0:
+				camera.zoom_to_fit();
+				break;
+			default:
+				break;
+			}
+		}
+		else if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0) {
+			camera.zoom_by(std::pow(Camera::zoom_step, event.wheel.y));
+		}
+	}
+
 	void render(SDL_Renderer* renderer, const Level* level) {
 		level_dimensions = level->get_level_dimensions();
 
-		std::optional<Tile> current_tile = ((((level_dimensions.first) > (level_dimensions.second)) ? (level_dimensions.first) : (level_dimensions.second)) > 15)
-			? small_set
-			: big_set;
-
-		std::pair<int, int> render_size_level = rendering_size(level_dimensions, *current_tile);
-		render_screen(renderer, level, *current_tile);
-
-		int screen_width = current_tile->get_screen_width();
-		int screen_height = current_tile->get_screen_height();
-
-		double width_ratio = static_cast<double>(screen_width) / static_cast<double>(render_size_level.first);
-		int h = screen_height - 32;
-		double height_ratio = static_cast<double>(h) / static_cast<double>(render_size_level.second);
-		double ratio = (width_ratio < height_ratio) ? ((width_ratio < 1.0) ? width_ratio : 1.0) : ((height_ratio < 1.0) ? height_ratio : 1.0);
-		auto scale = [ratio](int sz) -> int {
-			return static_cast<int>(std::floor(ratio * static_cast<double>(sz)));
-			};
-		std::pair<int, int> scaled_render_size = std::make_pair(scale(render_size_level.first), scale(render_size_level.second));
-
-		int x = (screen_width - scaled_render_size.first) / 2;
-		int y = (screen_height - 32 - scaled_render_size.second) / 2;
-		SDL_Rect rect = { x, y, scaled_render_size.first, scaled_render_size.second };
-		status_bar(renderer, level, *current_tile);
+		auto now = std::chrono::steady_clock::now();
+		if (level->get_layout_id() != layout_id) {
+			build_layout(level);
+			SDL_Rect view = { 0, 0, tiles.get_screen_width(), tiles.get_screen_height() - 32 };
+			camera.reset(level_dimensions, level->get_player(), view);
+		}
+		else {
+			camera.update(level->get_player(), std::chrono::duration<double>(now - last_frame).count());
+		}
+		last_frame = now;
+
+		// Halve the sheet size while the cells stay at or below half of it, so sprites are
+		// never shrunk on the GPU by more than two.
+		int tile_width = tiles.get_width();
+		while (tile_width > min_tile_width && camera.get_cell_width() <= tile_width / 2) {
+			tile_width /= 2;
+		}
+		const Tile& current_tile = tiles.get(tile_width);
+		SDL_RenderSetClipRect(renderer, &camera.get_viewport());
+		render_screen(renderer, level, current_tile);
+		SDL_RenderSetClipRect(renderer, nullptr);
+		status_bar(renderer, level, current_tile);
 		return;
 	}
-	void render_screen(SDL_Renderer* renderer, const Level* level, Tile current_tile) {
-
-		for (int i = 0; i < level_dimensions.second; i++) {
-			for (int j = 0; j < level_dimensions.first; j++) {
-				std::pair<int, int > pos = std::make_pair(j, i);
-				auto coordinates = current_tile.get_coordinates(pos);
-				if (level->check_squares_pos(pos)) {
-					draw_tile(current_tile, 11, 0, coordinates.first, coordinates.second);
+
+	// Draws only the cells under the camera, so the cost follows the screen size and
+	// zoom rather than the level size.
+	void render_screen(SDL_Renderer* renderer, const Level* level, const Tile& current_tile) {
+		SDL_Rect visible = camera.visible_cells();
+		visible_boxes.assign(static_cast<std::size_t>(visible.w) * visible.h, 0);
+		for (const auto& box : level->get_boxes()) {
+			int col = box.first - visible.x;
+			int row = box.second - visible.y;
+			if (col >= 0 && col < visible.w && row >= 0 && row < visible.h) {
+				visible_boxes[static_cast<std::size_t>(row) * visible.w + col] = 1;
+			}
+		}
+
+		double scale = camera.get_cell_width() / current_tile.get_width();
+		int tile_height = static_cast<int>(std::lround(current_tile.get_height() * scale));
+		int offset = static_cast<int>(std::lround(current_tile.get_offset() * scale));
+		std::pair<int, int> player = level->get_player();
+
+		for (int i = visible.y; i < visible.y + visible.h; i++) {
+			int y = camera.to_screen(0, i).second;
+			int next_y = camera.to_screen(0, i + 1).second;
+			for (int j = visible.x; j < visible.x + visible.w; j++) {
+				int x = camera.to_screen(j, 0).first;
+				int w = camera.to_screen(j + 1, 0).first - x;
+				uint8_t cell = layout[static_cast<std::size_t>(i) * level_dimensions.first + j];
+				bool box = visible_boxes[static_cast<std::size_t>(i - visible.y) * visible.w + (j - visible.x)] != 0;
+
+				SDL_Rect floor_rect = { x, y, w, tile_height };
+				if (cell & cell_goal) {
+					draw_tile(current_tile, 11, 0, floor_rect);
 				}
 				else {
-					draw_tile(current_tile, 10, 0, coordinates.first, coordinates.second);
+					draw_tile(current_tile, 10, 0, floor_rect);
 				}
-				int offset = coordinates.second - current_tile.get_offset();
-				if (level->check_walls_pos(pos)) {
-					draw_tile(current_tile, 7, 7, coordinates.first, offset);
+				SDL_Rect sprite_rect = { x, y - offset, w, next_y - y + offset };
+				if (cell & cell_wall) {
+					draw_tile(current_tile, 7, 7, sprite_rect);
 				}
-				if (level->check_boxes_pos(pos)) {
-					if (level->check_squares_pos(pos)) {
-						draw_tile(current_tile, 6, 4, coordinates.first, offset);
+				if (box) {
+					if (cell & cell_goal) {
+						draw_tile(current_tile, 6, 4, sprite_rect);
 					}
 					else {
-						draw_tile(current_tile, 6, 0, coordinates.first, offset);
+						draw_tile(current_tile, 6, 0, sprite_rect);
 					}
 				}
-				if (level->check_player_pos(pos)) {
-					if (Direction::Left == level->get_prev_dir()) {
-						draw_tile(current_tile, 3, 6, coordinates.first, offset);
-					}
-					else if (Direction::Right == level->get_prev_dir()) {
-						draw_tile(current_tile, 0, 6, coordinates.first, offset);
-					}
-					else if (Direction::Up == level->get_prev_dir()) {
-						draw_tile(current_tile, 3, 4, coordinates.first, offset);
-					}
-					else if (Direction::Down == level->get_prev_dir()) {
-						draw_tile(current_tile, 0, 4, coordinates.first, offset);
-					}
+				if (player == std::make_pair(j, i)) {
+					const int* sprite = player_sprites[static_cast<int>(level->get_prev_dir())];
+					draw_tile(current_tile, sprite[0], sprite[1], sprite_rect);
 				}
 			}
 		}
+		if (hint_move) {
+			std::pair<int, int> pos = level->get_next_position(*hint_move);
+			auto coordinates = camera.to_screen(pos.first, pos.second);
+			auto corner = camera.to_screen(pos.first + 1, pos.second + 1);
+			SDL_Rect hint_rect = { coordinates.first, coordinates.second, corner.first - coordinates.first, corner.second - coordinates.second };
+			SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+			SDL_SetRenderDrawColor(renderer, 0, 200, 0, 96);
+			SDL_RenderFillRect(renderer, &hint_rect);
+			SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+		}
 	}
 	std::pair<int, int> rendering_size(std::pair<int, int> t, Tile current_tile) {
 		int width = t.first * current_tile.get_width();
@@ -117,9 +188,15 @@ public:
 		return std::make_pair(width, height);
 	}
 
-	void status_bar(SDL_Renderer* renderer, const Level* level, Tile current_tile) {
+	void status_bar(SDL_Renderer* renderer, const Level* level, const Tile& current_tile) {
 		int steps = level->get_steps();
 		std::string moves = "amount of moves: " + std::to_string(steps) + "     level: " + level->get_title();
+		if (level->is_deadlocked()) {
+			moves += "     deadlocked, press R to retry";
+		}
+		if (!hint_status.empty()) {
+			moves += "     " + hint_status;
+		}
 
 		SDL_Color black = { 0, 0, 0, 255 };
 		draw_text(moves, 0, (current_tile.get_screen_height() - 32), black, current_tile.get_screen_width(), 32);
@@ -129,10 +206,34 @@ public:
 	}
 private:
 	SDL_Renderer* renderer;
-	Tile big_set;
-	Tile small_set;
+	static constexpr int min_tile_width = 16;
+	// Sheet cell of the player facing each Direction.
+	static constexpr int player_sprites[4][2] = { { 3, 6 }, { 0, 6 }, { 3, 4 }, { 0, 4 } };
+	TileCache& tiles;
 	std::pair<int, int> level_dimensions;
 	TTF_Font* font;
+	std::optional<Direction> hint_move;
+	std::string hint_status;
+
+	enum : uint8_t { cell_wall = 1, cell_goal = 2 };
+	Camera camera;
+	std::chrono::steady_clock::time_point last_frame;
+	uint64_t layout_id = 0;
+	std::vector<uint8_t> layout;
+	std::vector<uint8_t> visible_boxes;
+
+	// Walls and goals only change with the level, so they are looked up in a grid
+	// built once instead of scanning the level's lists for every cell.
+	void build_layout(const Level* level) {
+		layout_id = level->get_layout_id();
+		layout.assign(static_cast<std::size_t>(level_dimensions.first) * level_dimensions.second, 0);
+		for (const auto& wall : level->get_walls()) {
+			layout[static_cast<std::size_t>(wall.second) * level_dimensions.first + wall.first] |= cell_wall;
+		}
+		for (const auto& square : level->get_squares()) {
+			layout[static_cast<std::size_t>(square.second) * level_dimensions.first + square.first] |= cell_goal;
+		}
+	}
 };
 
 #endif
\ No newline at end of file
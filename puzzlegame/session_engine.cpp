@@ -0,0 +1,180 @@
+#include "session_engine.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+inline uint32_t test_bit(const uint32_t* words, uint32_t bit) { return words[bit >> 5] >> (bit & 31) & 1; }
+inline void set_bit(uint32_t* words, uint32_t bit) { words[bit >> 5] |= 1u << (bit & 31); }
+inline void clear_bit(uint32_t* words, uint32_t bit) { words[bit >> 5] &= ~(1u << (bit & 31)); }
+
+// Works out every move of a batch from the current state: the offset the player moves by
+// (0 when blocked) and whether a box is pushed. Left, Right, Up, Down map to -1, 1,
+// -stride and stride. Only 32-bit reads, branch-free selects and restrict pointers, so
+// compilers can turn it into gathers.
+void plan_moves(const uint32_t* __restrict sessions, const Direction* __restrict directions, std::size_t count,
+	const int32_t* __restrict strides, const uint32_t* __restrict players, const uint32_t* __restrict layout_start,
+	const uint32_t* __restrict walls, const uint32_t* __restrict box_start, const uint32_t* __restrict boxes,
+	int32_t* __restrict offsets, uint32_t* __restrict pushed) {
+	for (std::size_t i = 0; i < count; i++) {
+		uint32_t s = sessions[i];
+		int32_t d = static_cast<int32_t>(directions[i]);
+		int32_t stride = strides[s];
+		int32_t offset = d < 2 ? 2 * d - 1 : (2 * d - 5) * stride;
+		uint32_t next = players[s] + offset;
+		uint32_t beyond = next + offset;
+		// Indexing from the array base rather than a per-session pointer keeps these gathers.
+		uint32_t box_next = boxes[box_start[s] + (next >> 5)] >> (next & 31) & 1;
+		uint32_t box_beyond = boxes[box_start[s] + (beyond >> 5)] >> (beyond & 31) & 1;
+		uint32_t open_next = (walls[layout_start[s] + (next >> 5)] >> (next & 31) & 1) ^ 1;
+		uint32_t open_beyond = (walls[layout_start[s] + (beyond >> 5)] >> (beyond & 31) & 1) ^ 1;
+		uint32_t walk = open_next & (box_next ^ 1);
+		uint32_t push = box_next & open_beyond & (box_beyond ^ 1);
+		offsets[i] = offset * static_cast<int32_t>(walk | push);
+		pushed[i] = push;
+	}
+}
+
+}
+
+uint32_t SessionEngine::add_layout(const Level& level) {
+	// plan_moves reads two cells beyond the player without bounds checks, which the
+	// border only covers for a player, boxes and goals on the board.
+	auto on_board = [&level](const std::vector<std::pair<int, int>>& cells) {
+		return std::all_of(cells.begin(), cells.end(), [&level](std::pair<int, int> cell) { return level.on_board(cell); });
+	};
+	if (!level.on_board(level.get_player()) || !on_board(level.get_boxes()) || !on_board(level.get_squares())) {
+		throw std::runtime_error("Session engine needs a level with its player, boxes and goals on the board: " + level.get_title());
+	}
+	auto dimensions = level.get_level_dimensions();
+	Layout layout;
+	layout.width = dimensions.first + 2 * border;
+	int height = dimensions.second + 2 * border;
+	std::size_t count = static_cast<std::size_t>(layout.width) * height;
+	if (count > UINT32_MAX || wall_words.size() + count / 32 + 1 > UINT32_MAX) {
+		throw std::runtime_error("Session engine layouts exceed 4G cells");
+	}
+	layout.first_word = static_cast<uint32_t>(wall_words.size());
+	layout.words = static_cast<uint32_t>((count + 31) / 32);
+	auto index = [&layout](std::pair<int, int> pos) { return static_cast<uint32_t>((pos.second + border) * layout.width + pos.first + border); };
+
+	// Everything starts as wall; board cells are opened and the level's walls closed again.
+	wall_words.resize(wall_words.size() + layout.words, ~0u);
+	goal_words.resize(goal_words.size() + layout.words, 0);
+	uint32_t* walls = wall_words.data() + layout.first_word;
+	uint32_t* goals = goal_words.data() + layout.first_word;
+	const auto& board = level.get_board();
+	for (int y = 0; y < dimensions.second && y < static_cast<int>(board.size()); y++) {
+		for (int x = 0; x < dimensions.first && x < static_cast<int>(board[y].size()); x++) {
+			clear_bit(walls, index(std::make_pair(x, y)));
+		}
+	}
+	for (const auto& wall : level.get_walls()) {
+		set_bit(walls, index(wall));
+	}
+	for (const auto& square : level.get_squares()) {
+		set_bit(goals, index(square));
+	}
+
+	layout.boxes.assign(layout.words, 0);
+	layout.off_goal = 0;
+	for (const auto& box : level.get_boxes()) {
+		set_bit(layout.boxes.data(), index(box));
+		layout.off_goal += test_bit(goals, index(box)) ^ 1;
+	}
+	layout.balanced = level.get_boxes().size() == level.get_squares().size();
+	layout.player = static_cast<uint32_t>(index(level.get_player()));
+	layouts.push_back(std::move(layout));
+	return static_cast<uint32_t>(layouts.size() - 1);
+}
+
+uint32_t SessionEngine::add_session(uint32_t layout) {
+	if (layout >= layouts.size()) {
+		throw std::runtime_error("Unknown session layout " + std::to_string(layout));
+	}
+	const Layout& shape = layouts[layout];
+	uint32_t session = static_cast<uint32_t>(player.size());
+	layout_of.push_back(layout);
+	layout_word.push_back(shape.first_word);
+	row_stride.push_back(shape.width);
+	first_word.push_back(static_cast<uint32_t>(box_words.size()));
+	player.push_back(0);
+	steps.push_back(0);
+	pushes.push_back(0);
+	off_goal.push_back(0);
+	facing.push_back(static_cast<uint8_t>(Direction::Down));
+	box_words.resize(box_words.size() + shape.words);
+	batch_stamp.push_back(0);
+	reset(session);
+	return session;
+}
+
+void SessionEngine::reset(uint32_t session) {
+	const Layout& shape = layouts[layout_of[session]];
+	player[session] = shape.player;
+	steps[session] = 0;
+	pushes[session] = 0;
+	off_goal[session] = shape.off_goal;
+	facing[session] = static_cast<uint8_t>(Direction::Down);
+	std::copy(shape.boxes.begin(), shape.boxes.end(), box_words.begin() + first_word[session]);
+}
+
+void SessionEngine::step_batch(const std::vector<uint32_t>& sessions, const std::vector<Direction>& directions) {
+	if (sessions.size() != directions.size()) {
+		throw std::runtime_error("Session batch needs one direction per session");
+	}
+	step_batch(sessions.data(), directions.data(), sessions.size());
+}
+
+void SessionEngine::step_batch(const uint32_t* sessions, const Direction* directions, std::size_t count) {
+	if (move_offset.size() < count) {
+		move_offset.resize(count);
+		pushed.resize(count);
+	}
+	batch++;
+	for (std::size_t i = 0; i < count; i++) {
+		if (sessions[i] >= player.size() || batch_stamp[sessions[i]] == batch) {
+			throw std::runtime_error("Session batch names an unknown or repeated session " + std::to_string(sessions[i]));
+		}
+		batch_stamp[sessions[i]] = batch;
+	}
+
+	plan_moves(sessions, directions, count, row_stride.data(), player.data(), layout_word.data(), wall_words.data(),
+		first_word.data(), box_words.data(), move_offset.data(), pushed.data());
+
+	for (std::size_t i = 0; i < count; i++) {
+		uint32_t s = sessions[i];
+		int32_t offset = move_offset[i];
+		uint32_t next = player[s] + offset;
+		facing[s] = static_cast<uint8_t>(directions[i]);
+		steps[s] += offset != 0;
+		player[s] = next;
+		if (pushed[i]) {
+			uint32_t beyond = next + offset;
+			uint32_t* boxes = box_words.data() + first_word[s];
+			const uint32_t* goals = goal_words.data() + layout_word[s];
+			clear_bit(boxes, next);
+			set_bit(boxes, beyond);
+			off_goal[s] += test_bit(goals, next) - test_bit(goals, beyond);
+			pushes[s]++;
+		}
+	}
+}
+
+std::pair<int, int> SessionEngine::get_player(uint32_t session) const {
+	int width = row_stride[session];
+	return std::make_pair(static_cast<int>(player[session]) % width - border, static_cast<int>(player[session]) / width - border);
+}
+
+std::vector<std::pair<int, int>> SessionEngine::get_boxes(uint32_t session) const {
+	const Layout& shape = layouts[layout_of[session]];
+	std::vector<std::pair<int, int>> result;
+	const uint32_t* boxes = box_words.data() + first_word[session];
+	for (uint32_t cell = 0; cell < shape.words * 32; cell++) {
+		if (test_bit(boxes, cell)) {
+			result.push_back(std::make_pair(static_cast<int>(cell) % shape.width - border, static_cast<int>(cell) / shape.width - border));
+		}
+	}
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef SESSION_ENGINE_H_
+#define SESSION_ENGINE_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "level.h"
+
+// Many play sessions in one process. Walls and goals are stored once per layout; a
+// session is one entry in each of a set of parallel arrays (player cell, steps, pushes,
+// boxes off goal, facing) plus its boxes as a bitset over the layout's cells; walls and
+// goals are bitsets too, so every lookup is a 32-bit word. Sessions
+// follow Level::step, without deadlock detection.
+class SessionEngine {
+public:
+	// Sessions of one layout share its walls and goals. Returns the layout id. Throws for
+	// a level without a player on the board.
+	uint32_t add_layout(const Level& level);
+	// Starts a session in the layout's initial position and returns its id.
+	uint32_t add_session(uint32_t layout);
+	void reset(uint32_t session);
+
+	// Advances every listed session by one step. A batch may name a session only once.
+	// All moves are worked out from the current state first and applied afterwards, so
+	// the first pass only reads and runs without branches.
+	void step_batch(const uint32_t* sessions, const Direction* directions, std::size_t count);
+	void step_batch(const std::vector<uint32_t>& sessions, const std::vector<Direction>& directions);
+
+	std::size_t get_session_count() const { return player.size(); }
+	uint32_t get_layout(uint32_t session) const { return layout_of[session]; }
+	uint32_t get_steps(uint32_t session) const { return steps[session]; }
+	uint32_t get_pushes(uint32_t session) const { return pushes[session]; }
+	Direction get_prev_dir(uint32_t session) const { return static_cast<Direction>(facing[session]); }
+	bool is_completed(uint32_t session) const { return off_goal[session] == 0 && layouts[layout_of[session]].balanced; }
+	std::pair<int, int> get_player(uint32_t session) const;
+	std::vector<std::pair<int, int>> get_boxes(uint32_t session) const;
+
+private:
+	// Two rings of walls around every layout keep the cell beyond a blocked move inside
+	// the grid.
+	static const int border = 2;
+
+	struct Layout {
+		int width;
+		uint32_t first_word;
+		uint32_t words;
+		uint32_t player;
+		uint32_t off_goal;
+		bool balanced;
+		std::vector<uint32_t> boxes;
+	};
+
+	std::vector<Layout> layouts;
+	std::vector<uint32_t> wall_words;
+	std::vector<uint32_t> goal_words;
+
+	std::vector<uint32_t> layout_of;
+	std::vector<uint32_t> layout_word;
+	std::vector<int32_t> row_stride;
+	std::vector<uint32_t> first_word;
+	std::vector<uint32_t> player;
+	std::vector<uint32_t> steps;
+	std::vector<uint32_t> pushes;
+	std::vector<uint32_t> off_goal;
+	std::vector<uint8_t> facing;
+	std::vector<uint32_t> box_words;
+
+	std::vector<int32_t> move_offset;
+	std::vector<uint32_t> pushed;
+	std::vector<uint32_t> batch_stamp;
+	uint32_t batch = 0;
+};
+
+#endif
\ No newline at end of file
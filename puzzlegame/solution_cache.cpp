@@ -0,0 +1,234 @@
+#include "solution_cache.h"
+#include "solver.h"
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+};
+
+// Each record is a { payload size, payload checksum } pair followed by the payload.
+const std::size_t record_header_size = 8;
+
+template <typename T>
+void put(std::string& out, T value) {
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool get(const char*& data, const char* end, T& value) {
+	if (static_cast<std::size_t>(end - data) < sizeof(value)) return false;
+	std::memcpy(&value, data, sizeof(value));
+	data += sizeof(value);
+	return true;
+}
+
+uint32_t checksum(const char* data, std::size_t size) {
+	return static_cast<uint32_t>(hash128(data, size).low);
+}
+
+std::string encode(const LevelHash& hash, const CacheEntry& entry) {
+	std::string payload;
+	put(payload, hash.high);
+	put(payload, hash.low);
+	put(payload, entry.solver_version);
+	put(payload, static_cast<uint8_t>(entry.solved));
+	put(payload, static_cast<uint8_t>(entry.optimal));
+	put(payload, static_cast<uint16_t>(0));
+	put(payload, static_cast<int32_t>(entry.pushes));
+	put(payload, entry.max_nodes);
+	put(payload, entry.nodes_expanded);
+	put(payload, entry.nodes_generated);
+	put(payload, entry.seconds);
+	put(payload, static_cast<uint32_t>(entry.moves.size()));
+	for (Direction move : entry.moves) {
+		put(payload, static_cast<uint8_t>(move));
+	}
+
+	std::string record;
+	put(record, static_cast<uint32_t>(payload.size()));
+	put(record, checksum(payload.data(), payload.size()));
+	return record + payload;
+}
+
+bool decode(const char* data, const char* end, LevelHash& hash, CacheEntry& entry) {
+	uint8_t solved, optimal;
+	uint16_t reserved;
+	int32_t pushes;
+	uint32_t move_count;
+	if (!get(data, end, hash.high) || !get(data, end, hash.low) || !get(data, end, entry.solver_version)
+		|| !get(data, end, solved) || !get(data, end, optimal) || !get(data, end, reserved) || !get(data, end, pushes)
+		|| !get(data, end, entry.max_nodes) || !get(data, end, entry.nodes_expanded) || !get(data, end, entry.nodes_generated)
+		|| !get(data, end, entry.seconds) || !get(data, end, move_count)) {
+		return false;
+	}
+	if (static_cast<std::size_t>(end - data) != move_count) return false;
+	entry.solved = solved != 0;
+	entry.optimal = optimal != 0;
+	entry.pushes = pushes;
+	entry.moves.resize(move_count);
+	for (uint32_t i = 0; i < move_count; i++) {
+		if (static_cast<uint8_t>(data[i]) > static_cast<uint8_t>(Direction::Down)) return false;
+		entry.moves[i] = static_cast<Direction>(data[i]);
+	}
+	return true;
+}
+
+}
+
+SolutionCache::SolutionCache(const std::string& path, uint64_t compact_threshold) : path(path), compact_threshold(compact_threshold) {
+	load();
+}
+
+void SolutionCache::load() {
+	std::string contents;
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (file.is_open()) {
+			std::stringstream buffer;
+			buffer << file.rdbuf();
+			contents = buffer.str();
+		}
+	}
+
+	std::size_t valid = 0;
+	if (contents.size() >= sizeof(FileHeader)) {
+		FileHeader header;
+		std::memcpy(&header, contents.data(), sizeof(header));
+		if (header.magic != magic || header.version != version) {
+			throw std::runtime_error("Not a solution cache file: " + path);
+		}
+		valid = sizeof(FileHeader);
+	}
+
+	while (valid != 0 && contents.size() - valid >= record_header_size) {
+		uint32_t size, sum;
+		std::memcpy(&size, contents.data() + valid, sizeof(size));
+		std::memcpy(&sum, contents.data() + valid + 4, sizeof(sum));
+		const char* payload = contents.data() + valid + record_header_size;
+		if (contents.size() - valid - record_header_size < size || checksum(payload, size) != sum) break;
+
+		LevelHash hash;
+		Indexed indexed;
+		if (!decode(payload, payload + size, hash, indexed.entry)) break;
+		indexed.record_size = static_cast<uint32_t>(record_header_size + size);
+		auto it = index.find(hash);
+		if (it != index.end()) {
+			live_bytes -= it->second.record_size;
+		}
+		live_bytes += indexed.record_size;
+		index[hash] = std::move(indexed);
+		valid += record_header_size + size;
+	}
+
+	if (valid == 0) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		FileHeader header = { magic, version };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!file.good()) {
+			throw std::runtime_error("Failed to create solution cache: " + path);
+		}
+		valid = sizeof(FileHeader);
+	}
+	else if (valid < contents.size()) {
+		std::filesystem::resize_file(path, valid);
+	}
+
+	file_bytes = valid;
+	log.open(path, std::ios::binary | std::ios::app);
+	if (!log.is_open()) {
+		throw std::runtime_error("Failed to open solution cache: " + path);
+	}
+}
+
+bool SolutionCache::lookup(const LevelHash& hash, uint64_t max_nodes, CacheEntry& entry) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = index.find(hash);
+	if (it != index.end() && it->second.entry.solver_version == Solver::version) {
+		const CacheEntry& cached = it->second.entry;
+		if (cached.solved || cached.max_nodes == 0 || (max_nodes != 0 && max_nodes <= cached.max_nodes)) {
+			entry = cached;
+			stats.hits++;
+			return true;
+		}
+	}
+	stats.misses++;
+	return false;
+}
+
+void SolutionCache::store(const LevelHash& hash, const CacheEntry& entry) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = index.find(hash);
+	if (it != index.end() && it->second.entry.solver_version == entry.solver_version && it->second.entry.solved && !entry.solved) {
+		return;
+	}
+
+	std::string record = encode(hash, entry);
+	log.write(record.data(), record.size());
+	log.flush();
+	if (!log.good()) {
+		throw std::runtime_error("Failed to write solution cache: " + path);
+	}
+	file_bytes += record.size();
+	if (it != index.end()) {
+		live_bytes -= it->second.record_size;
+	}
+	live_bytes += record.size();
+	index[hash] = { entry, static_cast<uint32_t>(record.size()) };
+	stats.stores++;
+
+	if (file_bytes > compact_threshold && file_bytes > live_bytes * 2) {
+		rewrite();
+	}
+}
+
+void SolutionCache::compact() {
+	std::lock_guard<std::mutex> lock(mutex);
+	rewrite();
+}
+
+// Results of other solver versions are dropped here; until then they only cost disk space.
+void SolutionCache::rewrite() {
+	std::string temp_path = path + ".tmp";
+	std::ofstream temp(temp_path, std::ios::binary | std::ios::trunc);
+	FileHeader header = { magic, version };
+	temp.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t written = sizeof(header);
+	for (auto it = index.begin(); it != index.end();) {
+		if (it->second.entry.solver_version != Solver::version) {
+			it = index.erase(it);
+			continue;
+		}
+		std::string record = encode(it->first, it->second.entry);
+		temp.write(record.data(), record.size());
+		written += record.size();
+		++it;
+	}
+	temp.close();
+	if (!temp.good()) {
+		throw std::runtime_error("Failed to write solution cache: " + temp_path);
+	}
+
+	log.close();
+	std::filesystem::rename(temp_path, path);
+	log.open(path, std::ios::binary | std::ios::app);
+	if (!log.is_open()) {
+		throw std::runtime_error("Failed to open solution cache: " + path);
+	}
+	file_bytes = written;
+	live_bytes = written - sizeof(header);
+	stats.compactions++;
+}
+
+CacheStats SolutionCache::get_stats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	CacheStats result = stats;
+	result.entries = index.size();
+	result.file_bytes = file_bytes;
+	return result;
+}
@@ -0,0 +1,76 @@
+#ifndef SOLUTION_CACHE_H_
+#define SOLUTION_CACHE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "canonical.h"
+#include "level.h"
+
+struct CacheEntry {
+	uint32_t solver_version = 0;
+	bool solved = false;
+	bool optimal = false;
+	int pushes = 0;
+	uint64_t max_nodes = 0;
+	uint64_t nodes_expanded = 0;
+	uint64_t nodes_generated = 0;
+	double seconds = 0.0;
+	std::vector<Direction> moves;
+};
+
+struct CacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t stores = 0;
+	uint64_t compactions = 0;
+	std::size_t entries = 0;
+	uint64_t file_bytes = 0;
+};
+
+// Solver results keyed by level content hash. The file is an append-only log of
+// checksummed records; opening it replays the log into an in-memory index and cuts
+// off a torn last record, so a crash mid-write loses at most that record. Once stale
+// records make up most of the file it is rewritten to a temporary file and renamed
+// over the log.
+class SolutionCache {
+public:
+	static const uint32_t magic = 0x48435353; // "SSCH"
+	static const uint32_t version = 1;
+
+	explicit SolutionCache(const std::string& path, uint64_t compact_threshold = 4 << 20);
+
+	SolutionCache(const SolutionCache&) = delete;
+	SolutionCache& operator=(const SolutionCache&) = delete;
+
+	// Unsolved results only count as hits when they were searched with at least
+	// max_nodes, or without a limit.
+	bool lookup(const LevelHash& hash, uint64_t max_nodes, CacheEntry& entry);
+	void store(const LevelHash& hash, const CacheEntry& entry);
+	void compact();
+
+	CacheStats get_stats() const;
+
+private:
+	struct Indexed {
+		CacheEntry entry;
+		uint32_t record_size;
+	};
+
+	std::string path;
+	uint64_t compact_threshold;
+	mutable std::mutex mutex;
+	std::unordered_map<LevelHash, Indexed, LevelHashHasher> index;
+	std::ofstream log;
+	uint64_t file_bytes = 0;
+	uint64_t live_bytes = 0;
+	CacheStats stats;
+
+	void load();
+	void rewrite();
+};
+
+#endif
@@ -0,0 +1,787 @@
+#include "solver.h"
+#include "deadlock.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+const Direction directions[4] = { Direction::Left, Direction::Right, Direction::Up, Direction::Down };
+
+struct OpenEntry {
+	int f;
+	int g;
+	uint32_t node;
+
+	bool operator<(const OpenEntry& other) const {
+		if (f != other.f) return f > other.f;
+		return g < other.g;
+	}
+};
+
+}
+
+Solver::Solver(const Level& level, const SolverOptions& options) : options(options) {
+	auto dimensions = level.get_level_dimensions();
+	width = dimensions.first + 2;
+	height = dimensions.second + 2;
+	offsets[0] = -1;
+	offsets[1] = 1;
+	offsets[2] = -width;
+	offsets[3] = width;
+
+	std::size_t cells = static_cast<std::size_t>(width) * height;
+	if (cells > UINT16_MAX || !level.on_board(level.get_player())) {
+		return;
+	}
+	valid = true;
+	walls.assign(cells, 1);
+	goals.assign(cells, 0);
+	occupied.assign(cells, 0);
+	visit_stamp.assign(cells, 0);
+	parent_stamp.assign(cells, 0);
+	corral_mark.assign(cells, 0);
+
+	const auto& board = level.get_board();
+	for (int y = 0; y < dimensions.second && y < static_cast<int>(board.size()); y++) {
+		for (int x = 0; x < dimensions.first && x < static_cast<int>(board[y].size()); x++) {
+			walls[cell_index(std::make_pair(x, y))] = 0;
+		}
+	}
+	for (const auto& wall : level.get_walls()) {
+		walls[cell_index(wall)] = 1;
+	}
+	for (const auto& square : level.get_squares()) {
+		goals[cell_index(square)] = 1;
+	}
+	for (const auto& box : level.get_boxes()) {
+		start_boxes.push_back(static_cast<uint16_t>(cell_index(box)));
+	}
+	std::sort(start_boxes.begin(), start_boxes.end());
+	start_player = static_cast<uint16_t>(cell_index(level.get_player()));
+
+	compute_goal_distances();
+
+	if (options.macros) {
+		layout = analyze_layout(walls, goals, width, start_player, start_boxes);
+		room_rank.assign(cells, -1);
+		for (std::size_t k = 0; k < layout.room.fill_order.size(); k++) {
+			room_rank[layout.room.fill_order[k]] = static_cast<int>(k);
+		}
+	}
+
+	if (options.deadlocks) {
+		deadlock_cells.assign(cells, DeadlockDatabase::Floor);
+		for (std::size_t i = 0; i < cells; i++) {
+			if (walls[i]) deadlock_cells[i] = DeadlockDatabase::Wall;
+		}
+	}
+}
+
+// Reverse BFS from every goal: a box on cell b can reach t = b + d when the player can
+// stand on b - d. Cells that no goal reaches are dead squares.
+void Solver::compute_goal_distances() {
+	distance.assign(walls.size(), -1);
+	std::deque<int> open;
+	for (int i = 0; i < static_cast<int>(goals.size()); i++) {
+		if (goals[i]) {
+			distance[i] = 0;
+			open.push_back(i);
+		}
+	}
+	while (!open.empty()) {
+		int target = open.front();
+		open.pop_front();
+		for (int d = 0; d < 4; d++) {
+			int from = target - offsets[d];
+			int stand = from - offsets[d];
+			if (from < 0 || stand < 0 || from >= static_cast<int>(walls.size()) || stand >= static_cast<int>(walls.size())) continue;
+			if (walls[from] || walls[stand] || distance[from] >= 0) continue;
+			distance[from] = distance[target] + 1;
+			open.push_back(from);
+		}
+	}
+}
+
+int Solver::heuristic(const uint16_t* boxes) const {
+	int total = 0;
+	for (std::size_t i = 0; i < start_boxes.size(); i++) {
+		total += distance[boxes[i]];
+	}
+	return total;
+}
+
+// Flood fills the player's area over the current `occupied` boxes, stamping the visited
+// cells in `marks`, and returns the smallest cell index as the normalized player position.
+uint16_t Solver::reach(uint16_t player, std::vector<uint32_t>& marks) {
+	stamp++;
+	reach_queue.clear();
+	reach_queue.push_back(player);
+	marks[player] = stamp;
+	uint16_t smallest = player;
+	for (std::size_t i = 0; i < reach_queue.size(); i++) {
+		uint16_t cell = reach_queue[i];
+		smallest = std::min(smallest, cell);
+		for (int d = 0; d < 4; d++) {
+			int next = cell + offsets[d];
+			if (walls[next] || occupied[next] || marks[next] == stamp) continue;
+			marks[next] = stamp;
+			reach_queue.push_back(static_cast<uint16_t>(next));
+		}
+	}
+	return smallest;
+}
+
+bool Solver::is_pushed_deadlock(int box_cell) {
+	std::pair<int, int> box = std::make_pair(box_cell % width, box_cell / width);
+	return options.deadlocks->is_deadlocked(deadlock_cells.data(), width, height, box);
+}
+
+// A corral is a floor area the player cannot reach, fenced by boxes and walls. It is a
+// PI-corral when the player can stand behind every fence box wherever it could be pushed
+// from, and every such push goes into the corral (or against a wall, a dead square or
+// another fence box). If the corral still needs work, some fence box has to be pushed in
+// before anything else matters, so only those pushes are generated. The fence with the
+// fewest boxes is chosen and marked in corral_boxes. `occupied` holds the boxes and
+// parent_stamp == reachable the player's area.
+bool Solver::find_pi_corral(const uint16_t* boxes, uint32_t reachable) {
+	std::size_t box_count = start_boxes.size();
+	uint32_t first_id = corral_id + 1;
+	std::size_t best = box_count + 1;
+	for (std::size_t b = 0; b < box_count; b++) {
+		for (int d = 0; d < 4; d++) {
+			int start = boxes[b] + offsets[d];
+			if (walls[start] || occupied[start] || parent_stamp[start] == reachable || corral_mark[start] >= first_id) continue;
+
+			uint32_t id = ++corral_id;
+			bool needs_work = false;
+			reach_queue.clear();
+			reach_queue.push_back(static_cast<uint16_t>(start));
+			corral_mark[start] = id;
+			for (std::size_t i = 0; i < reach_queue.size(); i++) {
+				int cell = reach_queue[i];
+				needs_work = needs_work || goals[cell];
+				for (int e = 0; e < 4; e++) {
+					int next = cell + offsets[e];
+					if (walls[next] || occupied[next] || corral_mark[next] == id) continue;
+					corral_mark[next] = id;
+					reach_queue.push_back(static_cast<uint16_t>(next));
+				}
+			}
+
+			std::size_t fence = 0;
+			for (std::size_t i = 0; i < box_count; i++) {
+				int cell = boxes[i];
+				barrier[i] = 0;
+				for (int e = 0; e < 4 && !barrier[i]; e++) {
+					barrier[i] = corral_mark[cell + offsets[e]] == id && !occupied[cell + offsets[e]];
+				}
+				if (!barrier[i]) continue;
+				fence++;
+				needs_work = needs_work || !goals[cell];
+			}
+			// Fence boxes count as corral cells from here on; their own cells are never flooded.
+			for (std::size_t i = 0; i < box_count; i++) {
+				if (barrier[i]) corral_mark[boxes[i]] = id;
+			}
+			if (!needs_work || fence >= best) continue;
+
+			bool pi_corral = true;
+			for (std::size_t i = 0; i < box_count && pi_corral; i++) {
+				if (!barrier[i]) continue;
+				for (int e = 0; e < 4 && pi_corral; e++) {
+					int stand = boxes[i] - offsets[e];
+					int target = boxes[i] + offsets[e];
+					if (walls[stand] || corral_mark[stand] == id) continue;
+					if (parent_stamp[stand] != reachable) pi_corral = false;
+					else if (!walls[target] && corral_mark[target] != id && distance[target] >= 0) pi_corral = false;
+				}
+			}
+			if (pi_corral) {
+				best = fence;
+				std::copy(barrier.begin(), barrier.end(), corral_boxes.begin());
+			}
+		}
+	}
+	return best <= box_count;
+}
+
+// Follows a push onto from + d through tunnels and on into the goal room. Returns the cell
+// the box ends on, the pushes taken and the cell the player is left on; `occupied` holds
+// the boxes before the push.
+int Solver::macro_push(const uint16_t* boxes, int from, int d, int& pushes, int& behind) const {
+	int to = from + offsets[d];
+	pushes = 1;
+	behind = from;
+	uint8_t axis = d < 2 ? LayoutAnalysis::HorizontalTunnel : LayoutAnalysis::VerticalTunnel;
+	for (;;) {
+		if (layout.has_room && to == layout.room.entrance && d == layout.room.inward) {
+			// The room is filled in order, so only a box entering while the inside holds
+			// exactly the first k goals can go straight to goal k.
+			int inside = 0;
+			int highest = -1;
+			for (std::size_t i = 0; i < start_boxes.size(); i++) {
+				if (!layout.room.inside[boxes[i]]) continue;
+				inside++;
+				highest = room_rank[boxes[i]] < 0 ? INT_MAX : std::max(highest, room_rank[boxes[i]]);
+			}
+			if (highest < inside && inside < static_cast<int>(layout.room.fill_order.size())) {
+				const std::vector<int>& path = layout.room.paths[inside];
+				pushes += static_cast<int>(path.size());
+				to = layout.room.fill_order[inside];
+				behind = to - offsets[path.back()];
+			}
+			return to;
+		}
+		int next = to + offsets[d];
+		if (goals[to] || !(layout.tunnel[to] & axis) || !(layout.tunnel[behind] & axis)) break;
+		if (walls[next] || occupied[next] || distance[next] < 0) break;
+		behind = to;
+		to = next;
+		pushes++;
+	}
+	return to;
+}
+
+uint32_t Solver::state_hash(const uint16_t* boxes, uint16_t player) const {
+	uint64_t hash = 0x9e3779b97f4a7c15ULL ^ player;
+	for (std::size_t i = 0; i < start_boxes.size(); i++) {
+		hash ^= boxes[i];
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 29;
+	}
+	return static_cast<uint32_t>(hash >> 32);
+}
+
+// Open addressing over node indices (stored + 1, 0 is empty). Returns the slot that holds
+// the matching node or the empty slot where it belongs.
+std::size_t Solver::find_slot(const uint16_t* boxes, uint16_t player, uint32_t hash) const {
+	std::size_t mask = closed.size() - 1;
+	std::size_t bytes = start_boxes.size() * sizeof(uint16_t);
+	for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+		uint32_t entry = closed[slot];
+		if (entry == 0) {
+			return slot;
+		}
+		Node* known = node(entry - 1);
+		if (known->hash == hash && known->player == player && std::memcmp(node_boxes(known), boxes, bytes) == 0) {
+			return slot;
+		}
+	}
+}
+
+void Solver::grow_closed() {
+	std::vector<uint32_t> old(closed.size() * 2, 0);
+	old.swap(closed);
+	std::size_t mask = closed.size() - 1;
+	for (uint32_t entry : old) {
+		if (entry == 0) continue;
+		std::size_t slot = node(entry - 1)->hash & mask;
+		while (closed[slot] != 0) slot = (slot + 1) & mask;
+		closed[slot] = entry;
+	}
+}
+
+uint32_t Solver::add_node(const uint16_t* boxes, uint16_t player, uint32_t hash) {
+	uint32_t index = pool->allocate();
+	Node* record = node(index);
+	record->hash = hash;
+	record->player = player;
+	record->replaced = 0;
+	std::memcpy(node_boxes(record), boxes, start_boxes.size() * sizeof(uint16_t));
+	return index;
+}
+
+Solution Solver::solve() {
+	auto start = std::chrono::steady_clock::now();
+	stats = SolverStats();
+	reported = SolverStats();
+	if (!valid) {
+		return Solution();
+	}
+	Arena& arena = thread_arena();
+	Arena::Marker marker = arena.mark();
+	pool = std::make_unique<NodePool>(arena, sizeof(Node) + start_boxes.size() * sizeof(uint16_t));
+	closed.assign(1 << 12, 0);
+	closed_count = 0;
+	child_boxes.resize(start_boxes.size());
+	corral_boxes.resize(start_boxes.size());
+	barrier.resize(start_boxes.size());
+
+	Solution solution;
+	bool dead_start = std::any_of(start_boxes.begin(), start_boxes.end(), [this](uint16_t box) { return distance[box] < 0; });
+	if (!dead_start) {
+		for (uint16_t box : start_boxes) occupied[box] = 1;
+		uint16_t player = reach(start_player, visit_stamp);
+		for (uint16_t box : start_boxes) occupied[box] = 0;
+
+		if (!options.scratch_dir.empty()) {
+			std::vector<std::pair<int, int>> pushes;
+			if (search_external(player, pushes)) {
+				solution = build_solution(pushes);
+			}
+		}
+		else {
+			uint32_t hash = state_hash(start_boxes.data(), player);
+			uint32_t root = add_node(start_boxes.data(), player, hash);
+			Node* record = node(root);
+			record->parent = root;
+			record->box_from = 0;
+			record->dir = 0;
+			record->g = 0;
+			record->h = heuristic(start_boxes.data());
+			closed[find_slot(start_boxes.data(), player, hash)] = root + 1;
+			closed_count = 1;
+
+			uint32_t goal_node = search(root);
+			if (goal_node != no_node) {
+				solution = build_solution(goal_node);
+			}
+		}
+	}
+
+	if (options.progress) {
+		options.progress->store(stats.nodes_expanded, std::memory_order_relaxed);
+	}
+	stats.memory = arena.get_stats();
+	pool.reset();
+	arena.release(marker);
+	report_telemetry(0);
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return solution;
+}
+
+// Calls emit(from, d, to, pushes, player) for every push out of the state, with the
+// child's sorted boxes in child_boxes and its normalized player position. With macros
+// the box may travel several cells, otherwise to is from + d and pushes is 1. Pushes
+// onto dead squares and into database deadlocks are skipped, and so are the pushes of
+// boxes outside the fence of a PI-corral.
+template <typename Emit>
+void Solver::for_each_push(const uint16_t* boxes, uint16_t player, Emit&& emit) {
+	std::size_t box_count = start_boxes.size();
+	for (std::size_t i = 0; i < box_count; i++) {
+		occupied[boxes[i]] = 1;
+		if (options.deadlocks) {
+			deadlock_cells[boxes[i]] = goals[boxes[i]] ? DeadlockDatabase::BoxOnGoal : DeadlockDatabase::Box;
+		}
+	}
+
+	reach(player, parent_stamp);
+	uint32_t reachable = stamp;
+	bool fenced = options.corrals && find_pi_corral(boxes, reachable);
+	if (fenced) {
+		stats.corral_prunes++;
+	}
+	for (std::size_t b = 0; b < box_count; b++) {
+		if (fenced && !corral_boxes[b]) continue;
+		int from = boxes[b];
+		for (int d = 0; d < 4; d++) {
+			int stand = from - offsets[d];
+			int target = from + offsets[d];
+			if (parent_stamp[stand] != reachable || walls[target] || occupied[target]) continue;
+			if (distance[target] < 0) {
+				stats.dead_square_prunes++;
+				continue;
+			}
+			stats.nodes_generated++;
+
+			int pushes = 1;
+			int behind = from;
+			if (options.macros) {
+				target = macro_push(boxes, from, d, pushes, behind);
+				if (pushes > 1) stats.macro_pushes++;
+			}
+
+			if (options.deadlocks) {
+				deadlock_cells[from] = DeadlockDatabase::Floor;
+				deadlock_cells[target] = goals[target] ? DeadlockDatabase::BoxOnGoal : DeadlockDatabase::Box;
+				bool deadlocked = is_pushed_deadlock(target);
+				deadlock_cells[target] = DeadlockDatabase::Floor;
+				deadlock_cells[from] = goals[from] ? DeadlockDatabase::BoxOnGoal : DeadlockDatabase::Box;
+				if (deadlocked) {
+					stats.deadlock_prunes++;
+					continue;
+				}
+			}
+
+			// Moving one box keeps the rest sorted, so the target is inserted in place.
+			std::size_t out = 0;
+			bool placed = false;
+			for (std::size_t i = 0; i < box_count; i++) {
+				if (i == b) continue;
+				if (!placed && target < boxes[i]) {
+					child_boxes[out++] = static_cast<uint16_t>(target);
+					placed = true;
+				}
+				child_boxes[out++] = boxes[i];
+			}
+			if (!placed) child_boxes[out] = static_cast<uint16_t>(target);
+
+			occupied[from] = 0;
+			occupied[target] = 1;
+			uint16_t child_player = reach(static_cast<uint16_t>(behind), visit_stamp);
+			occupied[target] = 0;
+			occupied[from] = 1;
+
+			emit(from, d, target, pushes, child_player);
+		}
+	}
+
+	for (std::size_t i = 0; i < box_count; i++) {
+		occupied[boxes[i]] = 0;
+		if (options.deadlocks) {
+			deadlock_cells[boxes[i]] = DeadlockDatabase::Floor;
+		}
+	}
+}
+
+// Counts an expansion and reports whether the node limit or a cancel request ends the search.
+bool Solver::should_stop(std::size_t frontier) {
+	stats.nodes_expanded++;
+	if ((stats.nodes_expanded & 1023) == 0) {
+		if (options.progress) {
+			options.progress->store(stats.nodes_expanded, std::memory_order_relaxed);
+		}
+		report_telemetry(frontier);
+		if (options.cancel && options.cancel->load(std::memory_order_relaxed)) {
+			return true;
+		}
+	}
+	return options.max_nodes && stats.nodes_expanded > options.max_nodes;
+}
+
+// Adds what changed since the last report to the thread's counters. This thread is their
+// only writer, so relaxed loads and stores are enough.
+void Solver::report_telemetry(std::size_t frontier) {
+	SolverTelemetry* telemetry = options.telemetry;
+	if (!telemetry) {
+		return;
+	}
+	auto add = [](std::atomic<uint64_t>& counter, uint64_t now, uint64_t& before) {
+		counter.store(counter.load(std::memory_order_relaxed) + now - before, std::memory_order_relaxed);
+		before = now;
+	};
+	add(telemetry->nodes_expanded, stats.nodes_expanded, reported.nodes_expanded);
+	add(telemetry->nodes_generated, stats.nodes_generated, reported.nodes_generated);
+	add(telemetry->deadlock_prunes, stats.deadlock_prunes, reported.deadlock_prunes);
+	add(telemetry->dead_square_prunes, stats.dead_square_prunes, reported.dead_square_prunes);
+	add(telemetry->corral_prunes, stats.corral_prunes, reported.corral_prunes);
+	telemetry->frontier.store(frontier, std::memory_order_relaxed);
+	telemetry->table_entries.store(closed_count, std::memory_order_relaxed);
+	telemetry->table_slots.store(closed.size(), std::memory_order_relaxed);
+	telemetry->arena_bytes.store(thread_arena().get_stats().bytes_in_use, std::memory_order_relaxed);
+}
+
+uint32_t Solver::search(uint32_t root) {
+	std::priority_queue<OpenEntry> open;
+	open.push({ priority(0, node(root)->h), 0, root });
+
+	while (!open.empty()) {
+		OpenEntry entry = open.top();
+		open.pop();
+		Node* parent = node(entry.node);
+		if (parent->replaced) {
+			continue;
+		}
+		if (parent->h == 0) {
+			return entry.node;
+		}
+		if (should_stop(open.size())) {
+			break;
+		}
+
+		int g = parent->g;
+		int h = parent->h;
+		for_each_push(node_boxes(parent), parent->player, [&](int from, int d, int to, int pushes, uint16_t player) {
+			uint32_t hash = state_hash(child_boxes.data(), player);
+			std::size_t slot = find_slot(child_boxes.data(), player, hash);
+			if (closed[slot] != 0) {
+				Node* known = node(closed[slot] - 1);
+				if (known->g <= g + pushes) {
+					stats.duplicates++;
+					return;
+				}
+				known->replaced = 1;
+			}
+			else {
+				closed_count++;
+			}
+
+			uint32_t index = add_node(child_boxes.data(), player, hash);
+			Node* child = node(index);
+			child->parent = entry.node;
+			child->box_from = static_cast<uint16_t>(from);
+			child->dir = pushes > 1 ? macro_dir : static_cast<uint8_t>(d);
+			child->g = g + pushes;
+			child->h = h - distance[from] + distance[to];
+			closed[slot] = index + 1;
+			if (closed_count * 2 > closed.size()) {
+				grow_closed();
+			}
+			open.push({ priority(child->g, child->h), child->g, index });
+		});
+	}
+	return no_node;
+}
+
+// Records hold the box cells and then the player, each as a big-endian uint16, so sorting
+// them as byte strings orders states consistently.
+void Solver::pack_state(const uint16_t* boxes, uint16_t player, uint8_t* record) const {
+	std::size_t box_count = start_boxes.size();
+	for (std::size_t i = 0; i < box_count; i++) {
+		record[2 * i] = static_cast<uint8_t>(boxes[i] >> 8);
+		record[2 * i + 1] = static_cast<uint8_t>(boxes[i]);
+	}
+	record[2 * box_count] = static_cast<uint8_t>(player >> 8);
+	record[2 * box_count + 1] = static_cast<uint8_t>(player);
+}
+
+void Solver::unpack_state(const uint8_t* record, uint16_t* boxes, uint16_t& player) const {
+	std::size_t box_count = start_boxes.size();
+	for (std::size_t i = 0; i < box_count; i++) {
+		boxes[i] = static_cast<uint16_t>(record[2 * i] << 8 | record[2 * i + 1]);
+	}
+	player = static_cast<uint16_t>(record[2 * box_count] << 8 | record[2 * box_count + 1]);
+}
+
+// Breadth-first search with delayed duplicate detection. Each layer is a sorted file that
+// is streamed and expanded; children are spilled as sorted runs within the memory budget,
+// then merged and subtracted from the sorted file of every state seen so far to form the
+// next layer. Pushes are irreversible, so all earlier layers take part in the subtraction.
+// The path is recovered afterwards by scanning the layers backwards for a parent.
+bool Solver::search_external(uint16_t root_player, std::vector<std::pair<int, int>>& pushes) {
+	namespace fs = std::filesystem;
+	static std::atomic<uint64_t> searches(0);
+	fs::path directory = fs::path(options.scratch_dir) / ("search-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())
+		+ "-" + std::to_string(searches++));
+	fs::create_directories(directory);
+	struct Cleanup {
+		fs::path directory;
+		~Cleanup() {
+			std::error_code error;
+			fs::remove_all(directory, error);
+		}
+	} cleanup = { directory };
+
+	std::size_t box_count = start_boxes.size();
+	std::size_t record_size = (box_count + 1) * sizeof(uint16_t);
+	std::size_t block = io_block_size(options.memory_budget);
+	std::size_t sort_budget = options.memory_budget > 4 * block ? options.memory_budget - 2 * block : options.memory_budget / 2;
+	std::size_t merge_budget = options.memory_budget > 12 * block ? options.memory_budget - 6 * block : options.memory_budget / 2;
+	auto layer_path = [&directory](int depth) { return (directory / ("layer-" + std::to_string(depth))).string(); };
+	auto on_goals = [this](const uint16_t* boxes) {
+		return std::all_of(boxes, boxes + start_boxes.size(), [this](uint16_t box) { return goals[box] != 0; });
+	};
+
+	if (on_goals(start_boxes.data())) {
+		return true;
+	}
+
+	std::vector<uint8_t> record(record_size);
+	std::vector<uint8_t> goal_parent(record_size);
+	std::vector<uint16_t> boxes(box_count);
+	std::pair<int, int> goal_push;
+	pack_state(start_boxes.data(), root_player, record.data());
+	std::string visited = (directory / "visited-0").string();
+	for (const std::string& path : { layer_path(0), visited }) {
+		RunWriter writer(path, block, stats.disk);
+		writer.write(record.data(), record_size);
+		writer.close();
+	}
+
+	int depth = 0;
+	for (bool found = false; !found; depth++) {
+		stats.layers = depth + 1;
+		uint64_t children = 0;
+		std::vector<std::string> runs;
+		{
+			RecordSorter sorter(directory.string(), record_size, sort_budget, stats.disk);
+			RunReader layer(layer_path(depth), record_size, block, stats.disk);
+			for (const uint8_t* state = layer.next(); state && !found; state = layer.next()) {
+				if (should_stop(children)) {
+					return false;
+				}
+				uint16_t player;
+				unpack_state(state, boxes.data(), player);
+				for_each_push(boxes.data(), player, [&](int from, int, int to, int, uint16_t child_player) {
+					if (found) {
+						return;
+					}
+					if (on_goals(child_boxes.data())) {
+						found = true;
+						goal_push = std::make_pair(from, to);
+						std::copy(state, state + record_size, goal_parent.begin());
+						return;
+					}
+					pack_state(child_boxes.data(), child_player, record.data());
+					sorter.add(record.data());
+					children++;
+				});
+			}
+			runs = sorter.finish();
+		}
+		if (found) {
+			break;
+		}
+
+		uint64_t fresh = 0;
+		std::string merged_path = (directory / ("visited-" + std::to_string(depth + 1))).string();
+		{
+			RunReader seen(visited, record_size, block, stats.disk);
+			RunWriter next(layer_path(depth + 1), block, stats.disk);
+			RunWriter merged(merged_path, block, stats.disk);
+			const uint8_t* known = seen.next();
+			merge_runs(runs, record_size, merge_budget, stats.disk, [&](const uint8_t* candidate) {
+				while (known && std::memcmp(known, candidate, record_size) < 0) {
+					merged.write(known, record_size);
+					known = seen.next();
+				}
+				if (known && std::memcmp(known, candidate, record_size) == 0) {
+					return;
+				}
+				merged.write(candidate, record_size);
+				next.write(candidate, record_size);
+				fresh++;
+			});
+			for (; known; known = seen.next()) {
+				merged.write(known, record_size);
+			}
+			next.close();
+			merged.close();
+		}
+		stats.duplicates += children - fresh;
+		for (const auto& run : runs) {
+			fs::remove(run);
+		}
+		fs::remove(visited);
+		visited = merged_path;
+		if (fresh == 0) {
+			return false;
+		}
+	}
+
+	// Walk back from the goal's parent: in every earlier layer find a state with a push
+	// that leads to the current one. Rescanning must not count as search work.
+	SolverStats search_stats = stats;
+	pushes.push_back(goal_push);
+	std::vector<uint8_t> target = goal_parent;
+	for (int layer_depth = depth - 1; layer_depth >= 0; layer_depth--) {
+		RunReader layer(layer_path(layer_depth), record_size, block, stats.disk);
+		bool hit = false;
+		for (const uint8_t* state = layer.next(); state && !hit; state = layer.next()) {
+			uint16_t player;
+			unpack_state(state, boxes.data(), player);
+			for_each_push(boxes.data(), player, [&](int from, int, int to, int, uint16_t child_player) {
+				if (hit) {
+					return;
+				}
+				pack_state(child_boxes.data(), child_player, record.data());
+				if (record == target) {
+					hit = true;
+					pushes.push_back(std::make_pair(from, to));
+				}
+			});
+			if (hit) {
+				target.assign(state, state + record_size);
+			}
+		}
+		if (!hit) {
+			throw std::runtime_error("External search lost the parent of a state in layer " + std::to_string(layer_depth + 1));
+		}
+	}
+	std::reverse(pushes.begin(), pushes.end());
+	search_stats.disk = stats.disk;
+	stats = search_stats;
+	return true;
+}
+
+std::vector<Direction> Solver::walk(int from, int to, const std::vector<uint8_t>& boxes) const {
+	std::vector<int> came_from(walls.size(), -1);
+	std::deque<int> open;
+	open.push_back(from);
+	came_from[from] = from;
+	while (!open.empty() && came_from[to] < 0) {
+		int cell = open.front();
+		open.pop_front();
+		for (int d = 0; d < 4; d++) {
+			int next = cell + offsets[d];
+			if (walls[next] || boxes[next] || came_from[next] >= 0) continue;
+			came_from[next] = cell;
+			open.push_back(next);
+		}
+	}
+
+	std::vector<Direction> path;
+	for (int cell = to; cell != from; cell = came_from[cell]) {
+		int step = cell - came_from[cell];
+		for (int d = 0; d < 4; d++) {
+			if (offsets[d] == step) {
+				path.push_back(directions[d]);
+				break;
+			}
+		}
+	}
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
+// The cell a node's box moved to is the one its boxes have and its parent's lack.
+Solution Solver::build_solution(uint32_t goal_node) const {
+	std::size_t box_count = start_boxes.size();
+	std::vector<std::pair<int, int>> pushes;
+	for (uint32_t index = goal_node; node(index)->parent != index; index = node(index)->parent) {
+		const uint16_t* boxes = node_boxes(node(index));
+		const uint16_t* parent_boxes = node_boxes(node(node(index)->parent));
+		uint16_t moved = 0;
+		std::set_difference(boxes, boxes + box_count, parent_boxes, parent_boxes + box_count, &moved);
+		pushes.push_back(std::make_pair(node(index)->box_from, moved));
+	}
+	std::reverse(pushes.begin(), pushes.end());
+	return build_solution(pushes);
+}
+
+// Replays (from, to) box moves from the start, adding the walks between pushes. A move
+// longer than one push is expanded into the shortest push path for that box.
+Solution Solver::build_solution(const std::vector<std::pair<int, int>>& pushes) const {
+	Solution solution;
+	solution.solved = true;
+	solution.optimal = !options.macros && (options.weight == 1 || !options.scratch_dir.empty());
+
+	std::vector<uint8_t> boxes(walls.size(), 0);
+	for (uint16_t box : start_boxes) boxes[box] = 1;
+	int player = start_player;
+	std::vector<int> path_directions;
+	for (const auto& push : pushes) {
+		int from = push.first;
+		int to = push.second;
+		const int* single = std::find(offsets, offsets + 4, to - from);
+		if (single != offsets + 4) {
+			path_directions.assign(1, static_cast<int>(single - offsets));
+		}
+		else {
+			std::vector<uint8_t> blocked(walls.size());
+			for (std::size_t i = 0; i < walls.size(); i++) blocked[i] = walls[i] | boxes[i];
+			blocked[from] = 0;
+			if (!find_box_path(blocked, width, from, player, to, path_directions)) {
+				throw std::runtime_error("Solver could not replay a macro push");
+			}
+		}
+		for (int d : path_directions) {
+			std::vector<Direction> path = walk(player, from - offsets[d], boxes);
+			solution.moves.insert(solution.moves.end(), path.begin(), path.end());
+			solution.moves.push_back(directions[d]);
+			boxes[from] = 0;
+			boxes[from + offsets[d]] = 1;
+			player = from;
+			from += offsets[d];
+			solution.pushes++;
+		}
+	}
+	return solution;
+}
\ No newline at end of file
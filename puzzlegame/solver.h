@@ -0,0 +1,166 @@
+#ifndef SOLVER_H_
+#define SOLVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "arena.h"
+#include "external_sort.h"
+#include "level.h"
+#include "level_analysis.h"
+
+class DeadlockDatabase;
+struct SolverTelemetry;
+
+struct SolverOptions {
+	const DeadlockDatabase* deadlocks = nullptr;
+	const std::atomic<bool>* cancel = nullptr;
+	std::atomic<uint64_t>* progress = nullptr;
+	uint64_t max_nodes = 0;
+	// When set, search breadth-first with the layers kept in sorted files under this
+	// directory instead of holding every state in memory.
+	std::string scratch_dir;
+	std::size_t memory_budget = std::size_t(1) << 30;
+	// Push boxes through tunnels and straight to their goal room slot as single moves.
+	// Fewer nodes, but solutions are no longer guaranteed push-optimal.
+	bool macros = false;
+	// Only push the boxes fencing a PI-corral when the state has one.
+	bool corrals = true;
+	// Weight of the heuristic in the open set order: 1 is A*, larger values trust the
+	// heuristic more and 0 orders by it alone (greedy best-first). Solutions are only
+	// push-optimal with 1. The disk based search ignores it.
+	int weight = 1;
+	// Counters of the calling thread, refreshed with the progress counter.
+	SolverTelemetry* telemetry = nullptr;
+};
+
+struct SolverStats {
+	uint64_t nodes_expanded = 0;
+	uint64_t nodes_generated = 0;
+	uint64_t duplicates = 0;
+	uint64_t dead_square_prunes = 0;
+	uint64_t deadlock_prunes = 0;
+	uint64_t macro_pushes = 0;
+	uint64_t corral_prunes = 0;
+	double seconds = 0.0;
+	ArenaStats memory;
+	uint32_t layers = 0;
+	ExternalStats disk;
+};
+
+struct Solution {
+	bool solved = false;
+	bool optimal = false;
+	int pushes = 0;
+	std::vector<Direction> moves;
+};
+
+// A* over push states: boxes plus the area the player can reach. The heuristic is the sum
+// of each box's push distance to its nearest goal, so solutions are push-optimal unless
+// macros or a heuristic weight are on. With a scratch directory the same states are searched breadth-first
+// from disk.
+class Solver {
+public:
+	// Bumped whenever a change can alter results, so cached solutions are not reused.
+	static const uint32_t version = 2;
+
+	explicit Solver(const Level& level, const SolverOptions& options = SolverOptions());
+
+	// False when the level has no player or more cells than a uint16_t can index. Such
+	// a solver only reports unsolved, and none of the board queries below may be used.
+	bool is_valid() const { return valid; }
+
+	Solution solve();
+
+	const SolverStats& get_stats() const { return stats; }
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	bool is_wall(int cell) const { return walls[cell] != 0; }
+	bool is_goal(int cell) const { return goals[cell] != 0; }
+	bool is_dead_square(int cell) const { return distance[cell] < 0; }
+	int get_goal_distance(int cell) const { return distance[cell]; }
+	int get_box_count() const { return static_cast<int>(start_boxes.size()); }
+	int get_start_player() const { return start_player; }
+	int get_offset(int direction) const { return offsets[direction]; }
+
+private:
+	// Fixed-size pool record; the node's sorted box cells follow the header. dir is
+	// macro_dir when the box travelled further than one cell.
+	struct Node {
+		uint32_t parent;
+		uint32_t hash;
+		int32_t g;
+		int32_t h;
+		uint16_t player;
+		uint16_t box_from;
+		uint8_t dir;
+		uint8_t replaced;
+	};
+
+	SolverOptions options;
+	SolverStats stats;
+	bool valid = false;
+	// What has already been added to the telemetry counters.
+	SolverStats reported;
+
+	int width;
+	int height;
+	int offsets[4];
+	std::vector<uint8_t> walls;
+	std::vector<uint8_t> goals;
+	std::vector<int> distance;
+	std::vector<uint16_t> start_boxes;
+	uint16_t start_player;
+	LayoutAnalysis layout;
+	std::vector<int> room_rank;
+
+	std::unique_ptr<NodePool> pool;
+	std::vector<uint32_t> closed;
+	std::size_t closed_count = 0;
+	std::vector<uint16_t> child_boxes;
+
+	std::vector<uint8_t> occupied;
+	std::vector<uint8_t> deadlock_cells;
+	std::vector<uint32_t> visit_stamp;
+	std::vector<uint32_t> parent_stamp;
+	std::vector<uint16_t> reach_queue;
+	uint32_t stamp = 0;
+	std::vector<uint32_t> corral_mark;
+	uint32_t corral_id = 0;
+	std::vector<uint8_t> corral_boxes;
+	std::vector<uint8_t> barrier;
+
+	int cell_index(std::pair<int, int> pos) const { return (pos.second + 1) * width + pos.first + 1; }
+	void compute_goal_distances();
+	int heuristic(const uint16_t* boxes) const;
+	uint16_t reach(uint16_t player, std::vector<uint32_t>& marks);
+	bool is_pushed_deadlock(int box_cell);
+	bool find_pi_corral(const uint16_t* boxes, uint32_t reachable);
+	int macro_push(const uint16_t* boxes, int from, int d, int& pushes, int& behind) const;
+	static const uint32_t no_node = 0xffffffffu;
+	static const uint8_t macro_dir = 4;
+	int priority(int g, int h) const { return options.weight ? g + options.weight * h : h; }
+
+	Node* node(uint32_t index) const { return static_cast<Node*>(pool->get(index)); }
+	uint16_t* node_boxes(Node* record) const { return reinterpret_cast<uint16_t*>(record + 1); }
+	uint32_t state_hash(const uint16_t* boxes, uint16_t player) const;
+	std::size_t find_slot(const uint16_t* boxes, uint16_t player, uint32_t hash) const;
+	void grow_closed();
+	uint32_t add_node(const uint16_t* boxes, uint16_t player, uint32_t hash);
+	template <typename Emit>
+	void for_each_push(const uint16_t* boxes, uint16_t player, Emit&& emit);
+	bool should_stop(std::size_t frontier);
+	void report_telemetry(std::size_t frontier);
+	uint32_t search(uint32_t root);
+	void pack_state(const uint16_t* boxes, uint16_t player, uint8_t* record) const;
+	void unpack_state(const uint8_t* record, uint16_t* boxes, uint16_t& player) const;
+	bool search_external(uint16_t player, std::vector<std::pair<int, int>>& pushes);
+	std::vector<Direction> walk(int from, int to, const std::vector<uint8_t>& boxes) const;
+	Solution build_solution(uint32_t goal_node) const;
+	Solution build_solution(const std::vector<std::pair<int, int>>& pushes) const;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "stream.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const std::size_t chunk_size = 1 << 16;
+
+}
+
+FileStream::FileStream(const std::string& path) : file(path, std::ios::binary) {
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open level file: " + path);
+	}
+}
+
+std::size_t FileStream::read(char* buffer, std::size_t size) {
+	file.read(buffer, size);
+	return static_cast<std::size_t>(file.gcount());
+}
+
+GzipStream::GzipStream(std::unique_ptr<ByteStream> source)
+	: source(std::move(source)), input(chunk_size), inflater(std::make_unique<z_stream>()) {
+	// 16 + MAX_WBITS: gzip wrapper only, with the member CRC-32 and size checked.
+	if (inflateInit2(inflater.get(), 16 + MAX_WBITS) != Z_OK) {
+		throw std::runtime_error("Failed to initialize gzip decoder");
+	}
+}
+
+GzipStream::~GzipStream() {
+	inflateEnd(inflater.get());
+}
+
+// Moves the unread input to the front of the buffer and appends what the source has.
+bool GzipStream::refill() {
+	z_stream& z = *inflater;
+	if (z.avail_in != 0) {
+		std::memmove(input.data(), z.next_in, z.avail_in);
+	}
+	std::size_t count = source->read(input.data() + z.avail_in, input.size() - z.avail_in);
+	z.next_in = reinterpret_cast<Bytef*>(input.data());
+	z.avail_in += static_cast<uInt>(count);
+	return count != 0;
+}
+
+std::size_t GzipStream::read(char* buffer, std::size_t size) {
+	z_stream& z = *inflater;
+	uInt space = static_cast<uInt>(std::min<std::size_t>(size, UINT_MAX));
+	z.next_out = reinterpret_cast<Bytef*>(buffer);
+	z.avail_out = space;
+	while (!finished && space != 0 && z.avail_out == space) {
+		if (!in_member) {
+			// Anything after the last member other than another gzip header is padding.
+			while (z.avail_in < 2 && refill()) {}
+			if (z.avail_in < 2 || z.next_in[0] != 0x1f || z.next_in[1] != 0x8b) {
+				finished = true;
+				break;
+			}
+			inflateReset(&z);
+			in_member = true;
+		}
+		if (z.avail_in == 0 && !refill()) {
+			throw std::runtime_error("Truncated gzip stream");
+		}
+		int result = inflate(&z, Z_NO_FLUSH);
+		if (result == Z_STREAM_END) {
+			in_member = false;
+		}
+		else if (result != Z_OK) {
+			throw std::runtime_error(std::string("Corrupt gzip stream: ") + (z.msg ? z.msg : "invalid data"));
+		}
+	}
+	return space - z.avail_out;
+}
+
+std::size_t MemoryStream::read(char* buffer, std::size_t size) {
+	std::size_t count = std::min(size, static_cast<std::size_t>(end - current));
+	std::memcpy(buffer, current, count);
+	current += count;
+	return count;
+}
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+	file_handle = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		unmap();
+		throw std::runtime_error("Failed to read file size: " + path);
+	}
+	view_size = static_cast<std::size_t>(size.QuadPart);
+	if (view_size == 0) {
+		return;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		unmap();
+		throw std::runtime_error("Failed to map file: " + path);
+	}
+	mapping_handle = mapping;
+	view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!view) {
+		unmap();
+		throw std::runtime_error("Failed to map file: " + path);
+	}
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open file: " + path);
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to read file size: " + path);
+	}
+	view_size = static_cast<std::size_t>(info.st_size);
+	if (view_size == 0) {
+		close(fd);
+		return;
+	}
+	void* mapped = mmap(nullptr, view_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Failed to map file: " + path);
+	}
+	view = static_cast<const char*>(mapped);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	unmap();
+}
+
+void MappedFile::unmap() {
+#ifdef _WIN32
+	if (view) {
+		UnmapViewOfFile(view);
+	}
+	if (mapping_handle) {
+		CloseHandle(static_cast<HANDLE>(mapping_handle));
+	}
+	if (file_handle) {
+		CloseHandle(static_cast<HANDLE>(file_handle));
+	}
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+#else
+	if (view) {
+		munmap(const_cast<char*>(view), view_size);
+	}
+#endif
+	view = nullptr;
+}
+
+ByteReader::ByteReader(std::unique_ptr<ByteStream> stream) : stream(std::move(stream)), buffer(chunk_size) {}
+
+bool ByteReader::fill() {
+	len = stream->read(buffer.data(), buffer.size());
+	pos = 0;
+	return len != 0;
+}
+
+bool ByteReader::read_line(std::string& line) {
+	line.clear();
+	if (pos == len && !fill()) return false;
+	read_until('\n', line);
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+	return true;
+}
+
+bool ByteReader::read_until(char delimiter, std::string& out) {
+	for (;;) {
+		if (pos == len && !fill()) return false;
+		const char* start = buffer.data() + pos;
+		const char* found = static_cast<const char*>(std::memchr(start, delimiter, len - pos));
+		if (found) {
+			out.append(start, found);
+			pos += found - start + 1;
+			return true;
+		}
+		out.append(start, len - pos);
+		pos = len;
+	}
+}
+
+int ByteReader::sniff() {
+	std::size_t i = pos;
+	for (;;) {
+		if (i == len) {
+			// Keep the unread bytes and append more so nothing is consumed.
+			if (pos > 0) {
+				std::memmove(buffer.data(), buffer.data() + pos, len - pos);
+				len -= pos;
+				i -= pos;
+				pos = 0;
+			}
+			if (len == buffer.size()) {
+				buffer.resize(buffer.size() * 2);
+			}
+			std::size_t got = stream->read(buffer.data() + len, buffer.size() - len);
+			if (got == 0) return -1;
+			len += got;
+		}
+		unsigned char c = static_cast<unsigned char>(buffer[i]);
+		bool bom = c == 0xef || c == 0xbb || c == 0xbf;
+		if (!bom && c != ' ' && c != '\t' && c != '\r' && c != '\n') return c;
+		i++;
+	}
+}
+
+std::unique_ptr<ByteStream> open_byte_stream(const std::string& path) {
+	unsigned char magic[2] = {};
+	{
+		std::ifstream probe(path, std::ios::binary);
+		probe.read(reinterpret_cast<char*>(magic), 2);
+	}
+	std::unique_ptr<ByteStream> stream = std::make_unique<FileStream>(path);
+	if (magic[0] == 0x1f && magic[1] == 0x8b) {
+		stream = std::make_unique<GzipStream>(std::move(stream));
+	}
+	return stream;
+}
@@ -0,0 +1,116 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+// Sequential source of bytes. read returns 0 only at the end of the stream.
+class ByteStream {
+public:
+	virtual ~ByteStream() = default;
+	virtual std::size_t read(char* buffer, std::size_t size) = 0;
+};
+
+class FileStream : public ByteStream {
+public:
+	explicit FileStream(const std::string& path);
+
+	std::size_t read(char* buffer, std::size_t size) override;
+
+private:
+	std::ifstream file;
+};
+
+// Reads a range of memory owned by someone else.
+class MemoryStream : public ByteStream {
+public:
+	MemoryStream(const char* begin, const char* end) : current(begin), end(end) {}
+
+	std::size_t read(char* buffer, std::size_t size) override;
+
+private:
+	const char* current;
+	const char* end;
+};
+
+// A whole file mapped read-only into memory.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return view; }
+	std::size_t size() const { return view_size; }
+
+private:
+	const char* view = nullptr;
+	std::size_t view_size = 0;
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+
+	void unmap();
+};
+
+// Decompresses gzip data through zlib one input buffer at a time. Concatenated members
+// are read as one stream and every member's CRC-32 is checked.
+class GzipStream : public ByteStream {
+public:
+	explicit GzipStream(std::unique_ptr<ByteStream> source);
+	~GzipStream();
+
+	GzipStream(const GzipStream&) = delete;
+	GzipStream& operator=(const GzipStream&) = delete;
+
+	std::size_t read(char* buffer, std::size_t size) override;
+
+private:
+	std::unique_ptr<ByteStream> source;
+	std::vector<char> input;
+	std::unique_ptr<z_stream_s> inflater;
+	bool in_member = false;
+	bool finished = false;
+
+	bool refill();
+};
+
+// Buffered byte and line access on top of a ByteStream.
+class ByteReader {
+public:
+	explicit ByteReader(std::unique_ptr<ByteStream> stream);
+
+	int get() {
+		if (pos == len && !fill()) return -1;
+		return static_cast<unsigned char>(buffer[pos++]);
+	}
+
+	bool read_line(std::string& line);
+
+	// Appends everything up to the delimiter to out and consumes the delimiter. False
+	// when the stream ends first.
+	bool read_until(char delimiter, std::string& out);
+
+	// First byte that is not whitespace or a UTF-8 byte order mark, without consuming
+	// anything; -1 for an empty stream.
+	int sniff();
+
+private:
+	std::unique_ptr<ByteStream> stream;
+	std::vector<char> buffer;
+	std::size_t pos = 0;
+	std::size_t len = 0;
+
+	bool fill();
+};
+
+// Opens a file, transparently decompressing it when it starts with the gzip magic.
+std::unique_ptr<ByteStream> open_byte_stream(const std::string& path);
+
+#endif
@@ -0,0 +1,152 @@
+#include "telemetry.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+struct Metric {
+	const char* name;
+	const char* type;
+	const char* help;
+};
+
+void write_header(std::ostream& out, const Metric& metric) {
+	out << "# HELP " << metric.name << ' ' << metric.help << '\n';
+	out << "# TYPE " << metric.name << ' ' << metric.type << '\n';
+}
+
+}
+
+TelemetryPublisher::TelemetryPublisher(const std::string& path, std::chrono::milliseconds interval, unsigned slots)
+	: path(path), interval(interval), slot_count(slots), slots(new SolverTelemetry[slots]), last_nodes(slots, 0),
+	started(std::chrono::steady_clock::now()), last_publish(started) {
+	// Fail early on an unwritable path rather than on the first interval.
+	std::ofstream probe(path + ".tmp", std::ios::trunc);
+	if (!probe.is_open()) {
+		throw std::runtime_error("Failed to create telemetry file: " + path);
+	}
+	probe.close();
+	std::remove((path + ".tmp").c_str());
+	thread = std::thread(&TelemetryPublisher::run, this);
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	thread.join();
+	try {
+		publish();
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+	}
+}
+
+void TelemetryPublisher::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+		lock.unlock();
+		try {
+			publish();
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		lock.lock();
+	}
+}
+
+void TelemetryPublisher::publish() {
+	auto now = std::chrono::steady_clock::now();
+	double window = std::chrono::duration<double>(now - last_publish).count();
+	last_publish = now;
+
+	// One snapshot of every slot, so all metrics of a thread come from the same moment.
+	struct Snapshot {
+		uint64_t expanded, generated, deadlock, dead_square, corral, frontier, entries, table, arena, done, solved;
+		int64_t level;
+		double elapsed;
+	};
+	std::vector<Snapshot> snapshots(slot_count);
+	for (unsigned i = 0; i < slot_count; i++) {
+		const SolverTelemetry& slot = slots[i];
+		Snapshot& s = snapshots[i];
+		s.expanded = slot.nodes_expanded.load(std::memory_order_relaxed);
+		s.generated = slot.nodes_generated.load(std::memory_order_relaxed);
+		s.deadlock = slot.deadlock_prunes.load(std::memory_order_relaxed);
+		s.dead_square = slot.dead_square_prunes.load(std::memory_order_relaxed);
+		s.corral = slot.corral_prunes.load(std::memory_order_relaxed);
+		s.frontier = slot.frontier.load(std::memory_order_relaxed);
+		s.entries = slot.table_entries.load(std::memory_order_relaxed);
+		s.table = slot.table_slots.load(std::memory_order_relaxed);
+		s.arena = slot.arena_bytes.load(std::memory_order_relaxed);
+		s.done = slot.levels_done.load(std::memory_order_relaxed);
+		s.solved = slot.levels_solved.load(std::memory_order_relaxed);
+		s.level = slot.level.load(std::memory_order_relaxed);
+		int64_t level_started = slot.level_started.load(std::memory_order_relaxed);
+		s.elapsed = s.level < 0 ? 0.0 : std::chrono::duration<double>(now.time_since_epoch() - std::chrono::steady_clock::duration(level_started)).count();
+	}
+
+	std::ostringstream out;
+	auto series = [&out](const Metric& metric, const std::vector<Snapshot>& all, auto value) {
+		write_header(out, metric);
+		for (std::size_t i = 0; i < all.size(); i++) {
+			out << metric.name << "{thread=\"" << i << "\"} " << value(all[i], i) << '\n';
+		}
+	};
+	series({ "puzzlegame_nodes_expanded_total", "counter", "Search nodes expanded." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.expanded; });
+	series({ "puzzlegame_nodes_generated_total", "counter", "Search nodes generated." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.generated; });
+	series({ "puzzlegame_nodes_per_second", "gauge", "Nodes expanded per second since the previous snapshot." }, snapshots,
+		[this, window](const Snapshot& s, std::size_t i) { return window > 0.0 ? (s.expanded - last_nodes[i]) / window : 0.0; });
+	series({ "puzzlegame_frontier_nodes", "gauge", "Open nodes of the current search, or states in the next layer of a disk search." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.frontier; });
+	series({ "puzzlegame_table_entries", "gauge", "Entries in the transposition table of the current search." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.entries; });
+	series({ "puzzlegame_table_occupancy", "gauge", "Fraction of transposition table slots in use." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.table ? static_cast<double>(s.entries) / s.table : 0.0; });
+	series({ "puzzlegame_deadlock_prunes_total", "counter", "Pushes pruned by the deadlock database." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.deadlock; });
+	series({ "puzzlegame_dead_square_prunes_total", "counter", "Pushes pruned onto dead squares." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.dead_square; });
+	series({ "puzzlegame_corral_prunes_total", "counter", "States whose pushes were restricted to a PI-corral." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.corral; });
+	series({ "puzzlegame_arena_bytes", "gauge", "Bytes in use in the thread's search arena." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.arena; });
+	series({ "puzzlegame_level", "gauge", "Index of the level being solved, -1 when idle." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.level; });
+	series({ "puzzlegame_level_elapsed_seconds", "gauge", "Time spent on the current level." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.elapsed; });
+	series({ "puzzlegame_levels_total", "counter", "Levels finished." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.done; });
+	series({ "puzzlegame_levels_solved_total", "counter", "Levels solved." }, snapshots,
+		[](const Snapshot& s, std::size_t) { return s.solved; });
+	write_header(out, { "puzzlegame_uptime_seconds", "gauge", "Time since the publisher started." });
+	out << "puzzlegame_uptime_seconds " << std::chrono::duration<double>(now - started).count() << '\n';
+	for (unsigned i = 0; i < slot_count; i++) {
+		last_nodes[i] = snapshots[i].expanded;
+	}
+
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::trunc);
+		file << out.str();
+		if (!file) {
+			throw std::runtime_error("Failed to write telemetry file: " + temporary);
+		}
+	}
+	// Replaces the old file in one step, so a reader sees either snapshot but never no file.
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		throw std::runtime_error("Failed to replace telemetry file: " + path + ": " + error.message());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counters of one worker thread. Only that thread writes them, with relaxed stores, and
+// the publisher only reads them, so the search never takes a lock. Each slot has its own
+// cache lines.
+struct alignas(64) SolverTelemetry {
+	std::atomic<uint64_t> nodes_expanded{ 0 };
+	std::atomic<uint64_t> nodes_generated{ 0 };
+	std::atomic<uint64_t> deadlock_prunes{ 0 };
+	std::atomic<uint64_t> dead_square_prunes{ 0 };
+	std::atomic<uint64_t> corral_prunes{ 0 };
+	std::atomic<uint64_t> frontier{ 0 };
+	std::atomic<uint64_t> table_entries{ 0 };
+	std::atomic<uint64_t> table_slots{ 0 };
+	std::atomic<uint64_t> arena_bytes{ 0 };
+	std::atomic<uint64_t> levels_done{ 0 };
+	std::atomic<uint64_t> levels_solved{ 0 };
+	std::atomic<int64_t> level{ -1 };
+	// steady_clock nanoseconds when the current level started.
+	std::atomic<int64_t> level_started{ 0 };
+
+	void begin_level(std::size_t index) {
+		level_started.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		level.store(static_cast<int64_t>(index), std::memory_order_relaxed);
+	}
+
+	void end_level(bool solved) {
+		level.store(-1, std::memory_order_relaxed);
+		frontier.store(0, std::memory_order_relaxed);
+		table_entries.store(0, std::memory_order_relaxed);
+		table_slots.store(0, std::memory_order_relaxed);
+		levels_done.store(levels_done.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		levels_solved.store(levels_solved.load(std::memory_order_relaxed) + (solved ? 1 : 0), std::memory_order_relaxed);
+	}
+};
+
+// Writes the counters of every slot to a text file in the Prometheus exposition format
+// on a fixed interval, and once more when it is destroyed. The file is replaced through a
+// temporary so readers never see half a snapshot.
+class TelemetryPublisher {
+public:
+	TelemetryPublisher(const std::string& path, std::chrono::milliseconds interval, unsigned slots);
+	~TelemetryPublisher();
+
+	TelemetryPublisher(const TelemetryPublisher&) = delete;
+	TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+
+	SolverTelemetry* get_slot(unsigned index) { return index < slot_count ? &slots[index] : nullptr; }
+
+private:
+	std::string path;
+	std::chrono::milliseconds interval;
+	unsigned slot_count;
+	std::unique_ptr<SolverTelemetry[]> slots;
+	std::vector<uint64_t> last_nodes;
+	std::chrono::steady_clock::time_point started;
+	std::chrono::steady_clock::time_point last_publish;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::thread thread;
+
+	void run();
+	void publish();
+};
+
+#endif
\ No newline at end of file
@@ -10,8 +10,11 @@
 class Tile {
 
 public:
-	Tile(SDL_Texture* texture, int width, int height, int effective_height, int offset, int png_width, int png_height, int screen_width, int screen_height)
-		: texture(texture), width(width), height(height), effective_height(effective_height), offset(offset), png_width(png_width), png_height(png_height), screen_width(screen_width), screen_height(screen_height) {}
+	// sprites maps sheet (col, row) to a rect in a packed texture; when empty the
+	// texture is the sheet itself.
+	Tile(SDL_Texture* texture, int width, int height, int effective_height, int offset, int png_width, int png_height, int screen_width, int screen_height,
+		std::map<std::pair<int, int>, SDL_Rect> sprites = {})
+		: texture(texture), width(width), height(height), effective_height(effective_height), offset(offset), png_width(png_width), png_height(png_height), screen_width(screen_width), screen_height(screen_height), sprites(std::move(sprites)) {}
 
 
 	SDL_Texture* get_texture() const { return texture; }
@@ -33,6 +36,10 @@ public:
 	int get_screen_height() const { return screen_height; }
 
 	SDL_Rect get_tile_rect(int col, int row) const {
+		if (!sprites.empty()) {
+			auto it = sprites.find(std::make_pair(col, row));
+			return (it != sprites.end()) ? it->second : SDL_Rect{ 0, 0, 0, 0 };
+		}
 
 		int tiles_per_row = png_width / width;
 		int tiles_per_col = png_height / height;
@@ -63,6 +70,7 @@ private:
 	int png_height;
 	int screen_height;
 	int screen_width;
+	std::map<std::pair<int, int>, SDL_Rect> sprites;
 
 };
 
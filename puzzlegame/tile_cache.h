@@ -0,0 +1,179 @@
+#ifndef TILE_CACHE_H_
+#define TILE_CACHE_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "tile.h"
+
+struct TileCacheStats {
+	int sets = 0;
+	std::size_t texture_bytes = 0;
+	std::size_t source_bytes = 0;
+	double decode_ms = 0.0;
+	double build_ms = 0.0;
+};
+
+// Builds tile sets of any size from one high resolution sheet. The sheet is decoded
+// on first use and only the sprites the renderer draws are kept; each requested
+// size is downscaled from them once and packed into a small texture.
+class TileCache {
+public:
+	TileCache(SDL_Renderer* renderer, const std::string& path, int width, int height, int effective_height, int offset,
+		int screen_width, int screen_height, const std::vector<std::pair<int, int>>& sprites)
+		: renderer(renderer), path(path), width(width), height(height), effective_height(effective_height), offset(offset),
+		screen_width(screen_width), screen_height(screen_height), sprites(sprites) {}
+
+	TileCache(const TileCache&) = delete;
+	TileCache& operator=(const TileCache&) = delete;
+
+	~TileCache() {
+		for (auto& set : sets) {
+			SDL_DestroyTexture(set.second->get_texture());
+		}
+	}
+
+	const Tile& get(int tile_width) {
+		auto it = sets.find(tile_width);
+		if (it != sets.end()) {
+			return *it->second;
+		}
+		if (source.empty()) {
+			decode();
+		}
+		auto start = std::chrono::steady_clock::now();
+		std::unique_ptr<Tile> set = build(tile_width);
+		stats.build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.sets++;
+		return *sets.emplace(tile_width, std::move(set)).first->second;
+	}
+
+	int get_width() const { return width; }
+
+	int get_effective_height() const { return effective_height; }
+
+	int get_offset() const { return offset; }
+
+	int get_screen_width() const { return screen_width; }
+
+	int get_screen_height() const { return screen_height; }
+
+	const TileCacheStats& get_stats() const { return stats; }
+
+private:
+	SDL_Renderer* renderer;
+	std::string path;
+	int width;
+	int height;
+	int effective_height;
+	int offset;
+	int screen_width;
+	int screen_height;
+	std::vector<std::pair<int, int>> sprites;
+	// RGBA pixels of the used sprites at full size, side by side in sprite order.
+	std::vector<uint8_t> source;
+	std::map<int, std::unique_ptr<Tile>> sets;
+	TileCacheStats stats;
+
+	void decode() {
+		auto start = std::chrono::steady_clock::now();
+		SDL_Surface* loaded = IMG_Load(path.c_str());
+		if (!loaded) {
+			throw std::runtime_error("Failed to load image: " + path + ", SDL_Error: " + std::string(SDL_GetError()));
+		}
+		SDL_Surface* sheet = loaded;
+		if (loaded->format->format != SDL_PIXELFORMAT_RGBA32) {
+			sheet = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_FreeSurface(loaded);
+		}
+		if (!sheet) {
+			throw std::runtime_error("Failed to convert image: " + path + ", SDL_Error: " + std::string(SDL_GetError()));
+		}
+
+		std::size_t row_bytes = static_cast<std::size_t>(width) * 4;
+		std::size_t source_pitch = row_bytes * sprites.size();
+		source.assign(source_pitch * height, 0);
+		for (std::size_t i = 0; i < sprites.size(); i++) {
+			int x = sprites[i].first * width;
+			int y = sprites[i].second * height;
+			if (x + width > sheet->w || y + height > sheet->h) {
+				SDL_FreeSurface(sheet);
+				throw std::runtime_error("Sprite outside of tile sheet: " + path);
+			}
+			for (int row = 0; row < height; row++) {
+				const uint8_t* from = static_cast<const uint8_t*>(sheet->pixels) + static_cast<std::size_t>(y + row) * sheet->pitch + static_cast<std::size_t>(x) * 4;
+				std::copy(from, from + row_bytes, source.begin() + row * source_pitch + i * row_bytes);
+			}
+		}
+		SDL_FreeSurface(sheet);
+		stats.source_bytes = source.size();
+		stats.decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::unique_ptr<Tile> build(int tile_width) {
+		int tile_height = std::max(1, static_cast<int>(std::lround(static_cast<double>(height) * tile_width / width)));
+		int tile_effective = std::max(1, static_cast<int>(std::lround(static_cast<double>(effective_height) * tile_width / width)));
+		int tile_offset = tile_height - tile_effective;
+
+		int atlas_width = tile_width * static_cast<int>(sprites.size());
+		std::vector<uint8_t> pixels(static_cast<std::size_t>(atlas_width) * tile_height * 4);
+		std::map<std::pair<int, int>, SDL_Rect> rects;
+		for (std::size_t i = 0; i < sprites.size(); i++) {
+			int x = static_cast<int>(i) * tile_width;
+			downscale(i, tile_width, tile_height, pixels.data() + static_cast<std::size_t>(x) * 4, atlas_width * 4);
+			rects[sprites[i]] = { x, 0, tile_width, tile_height };
+		}
+
+		SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas_width, tile_height);
+		if (!texture) {
+			throw std::runtime_error("Failed to create tile texture: SDL_Error: " + std::string(SDL_GetError()));
+		}
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		SDL_UpdateTexture(texture, nullptr, pixels.data(), atlas_width * 4);
+		stats.texture_bytes += pixels.size();
+
+		return std::make_unique<Tile>(texture, tile_width, tile_height, tile_effective, tile_offset, atlas_width, tile_height,
+			screen_width, screen_height, std::move(rects));
+	}
+
+	// Area filter: every target pixel averages the source pixels it covers, weighted
+	// by alpha so transparent borders do not darken the edges.
+	void downscale(std::size_t sprite, int tile_width, int tile_height, uint8_t* target, int target_pitch) const {
+		std::size_t source_pitch = static_cast<std::size_t>(width) * 4 * sprites.size();
+		const uint8_t* origin = source.data() + sprite * width * 4;
+		for (int ty = 0; ty < tile_height; ty++) {
+			int y0 = ty * height / tile_height;
+			int y1 = std::max(y0 + 1, (ty + 1) * height / tile_height);
+			for (int tx = 0; tx < tile_width; tx++) {
+				int x0 = tx * width / tile_width;
+				int x1 = std::max(x0 + 1, (tx + 1) * width / tile_width);
+				uint32_t sum[4] = { 0, 0, 0, 0 };
+				for (int sy = y0; sy < y1; sy++) {
+					const uint8_t* pixel = origin + sy * source_pitch + static_cast<std::size_t>(x0) * 4;
+					for (int sx = x0; sx < x1; sx++, pixel += 4) {
+						sum[0] += pixel[0] * pixel[3];
+						sum[1] += pixel[1] * pixel[3];
+						sum[2] += pixel[2] * pixel[3];
+						sum[3] += pixel[3];
+					}
+				}
+				uint8_t* out = target + ty * target_pitch + tx * 4;
+				uint32_t count = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+				for (int c = 0; c < 3; c++) {
+					out[c] = static_cast<uint8_t>(sum[3] ? (sum[c] + sum[3] / 2) / sum[3] : 0);
+				}
+				out[3] = static_cast<uint8_t>((sum[3] + count / 2) / count);
+			}
+		}
+	}
+};
+
+#endif
\ No newline at end of file